@@ -40,9 +40,17 @@ SOFTWARE.
     with these helper methods, or by the client itself.
 
     Limitations and features (a short list):
-    * not supported: UNICODE
+    * UNICODE: UTF-8 input; optional validation of the encoding
+      and of non-ASCII names (see Visitor::utf8()); UTF-16 input may be
+      converted with transcodeUtf16(); byte order mark is skipped;
+      without validation, names are ASCII only
     * skipped: comments, XML Declaration, Processing Instructions (PIs)
-    * DTD: only simple cases are parsed, and the whole content is skipped
+    * DTD: only simple cases are parsed; the internal subset is passed
+      to Visitor::doctype() (see ho_sax_schema.hpp for validation)
+    * namespaces: prefixed element and attribute names are passed as they
+      are (see ho_sax_namespace.hpp for resolution)
+    * raw markup of elements (outer and inner spans) may be passed
+      to the visitor, see Visitor::spans()
     * by default no conversion of: attribute values, XML Text, CDATA,
       escape codes
     * auxiliary conversion methods, including escape codes when appropriate:
@@ -54,11 +62,20 @@ SOFTWARE.
       allow double hyphens
     * error handling during parsing: parser calls visitors 'error()' method,
       and returns false
+    * lint mode (see lint()): all the errors of a document are collected
+      in one pass, as codes with positions; the parser resynchronizes
+      at the next tag, and repairs unbalanced closing tags
     * exceptions: the parser's methods do not throw; all exceptions thrown
       by during parsing by other libraries might be absorbed and handled as
       parse errors, if the HO_SAX_CATCH_EXCEPTIONS macro
       has been defined; note: the macro will become undefined in the end
       of the file
+    * compile-time feature selection: XmlSax is XmlSaxParser with all
+      the features; XmlSaxParser<Features> has the grammar of the given
+      xmlsax::Feature set only (e.g. xmlsax::AllFeatures & ~xmlsax::Cdata),
+      so each configuration is a distinct type; a disabled construct
+      is reported as an error ("... disabled"); without namespaces,
+      the reserved "xml:", "xmlns:" prefixes of attributes are accepted
 
     Usage: see ho_sax_ult.hpp to figure out what should work
     and how to use the parser.
@@ -70,20 +87,20 @@ SOFTWARE.
     * it seems that VS2010 Express has a bug, such that following tag
       cannot be matched (and it does not encounter on vs2015 and gcc/clang):
       <title  xml:lang = \"de-DE\"  available = \"true\" >
-    * the following regex that I planned to use in toString() method
-      does not match multiline patterns; why?
-      "^(\\s+)?(.*\\S)?(\\s+)?"
-    * On VS2010 Express the following regex that I planned to use
-      in toString() method reveals a behavior that could be a bug -
-      - for " " input sometimes regex match 3rd group
-      "(\\s+)?(\\S+(?:\\s+\\S+)*)?(\\s+)?"
 */
 
 #ifndef HO_SAX_HPP_
 #define HO_SAX_HPP_
 
+#include <algorithm>
 #include <assert.h>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <limits>
 #include <string>
 #include <vector>
 #include <regex>
@@ -91,7 +108,24 @@ SOFTWARE.
 
 namespace headeronly
 {
-class XmlSax
+namespace xmlsax
+{
+/// Grammar features of XmlSaxParser, to be combined with '|'
+enum Feature
+{
+    XmlDeclaration = 1 << 0,
+    Doctype = 1 << 1,
+    /// Processing Instructions
+    Pi = 1 << 2,
+    Cdata = 1 << 3,
+    /// Prefixed names (of elements and attributes)
+    Namespaces = 1 << 4,
+    AllFeatures = XmlDeclaration | Doctype | Pi | Cdata | Namespaces
+};
+} // xmlsax
+
+/// Types and conversions of the parser, independent of its features
+class XmlSaxBase
 {
 public: // types
     /// [begin, end) position of a content: element name,
@@ -125,6 +159,29 @@ public: // types
         virtual bool cdata(const String& /*content*/)
         { return true; }
 
+        /// Called with the internal subset of the document type
+        /// declaration (between '[' and ']'), e.g. to compile
+        /// <!ELEMENT> and <!ATTLIST> declarations (see ho_sax_schema.hpp)
+        virtual bool doctype(const String& /*declarations*/)
+        { return true; }
+
+        /// Called by parseFragments() after each root element;
+        /// fragment is [begin, end) of the whole element
+        virtual bool fragment(const String& /*fragment*/)
+        { return true; }
+
+        /// Called right before exit() if spans() is true, with the raw
+        /// markup of the element in the document, e.g. to forward it
+        /// without re-serialization (see XmlWriter::raw()):
+        /// @outer  from '<' of the start tag to right after the end tag
+        /// @inner  the content, between the tags; for an empty element tag
+        ///   it's empty, at the end of the tag
+        virtual bool span(
+            const String& /*element*/,
+            const String& /*outer*/,
+            const String& /*inner*/)
+        { return true; }
+
         /// Handle parsing error
         /// @info  error description
         /// @pos  position of the unparsed remainder
@@ -135,250 +192,465 @@ public: // types
         /// requiring extra - potentially expensive - processing.
         virtual bool validate()
         { return false; }
+
+        /// If true, the parser validates UTF-8 encoding of the document
+        /// (as it parses it, so events of the valid input preceding
+        /// an invalid sequence are passed), and accepts non-ASCII
+        /// characters of element and attribute names, checked against
+        /// XML Name rules; otherwise names are ASCII only.
+        virtual bool utf8()
+        { return false; }
+
+        /// If true, the parser calls span() for each element.
+        virtual bool spans()
+        { return false; }
     };
 
-public: // constructors
-    XmlSax(Visitor& visitor):
-        m_visitor(visitor)
-    {}
+    /// Parse error codes, see describe() for the messages
+    enum ErrorCode
+    {
+        InvalidStatement,
+        UnmatchedClosingTag,
+        MismatchedClosingTag,
+        DuplicatedAttribute,
+        InvalidName,
+        InvalidUtf8,
+        UnclosedElement,
+        XmlDeclarationDisabled,
+        DoctypeDisabled,
+        CdataDisabled,
+        PiDisabled,
+        NamespacesDisabled
+    };
+
+    /// Error found by lint(); the message is formatted on demand only
+    struct Diagnostic
+    {
+        ErrorCode code;
+        /// Position of the error in the document
+        const char* docPos;
+        /// Name the error refers to (expected closing tag, duplicated
+        /// attribute, ...), or (nullptr, nullptr)
+        String name;
+    };
+    typedef std::vector<Diagnostic> Diagnostics;
 
 public: // function members
-    // Parsing method; doc refers to a C-style string representing xml document
-    // Return false if parsing process failed, or a callback function
-    // returned false.
-    bool parse(const char* doc)
+    // Error message of a diagnostic, as passed to Visitor::error() by parse()
+    static std::string describe(const Diagnostic& diagnostic)
     {
-        assert(doc);
+        std::string s;
+        describe(diagnostic, s);
+        return s;
+    }
+    static void describe(const Diagnostic& diagnostic, std::string& s)
+    {
+        static const char* const messages[] = {
+            "ERROR: invalid/unhandled statement or unexpected EOF",
+            "ERROR: no matching opening attribute statement",
+            "ERROR: closing attribute statement mismatch; expected ",
+            "ERROR: duplicated attribute: ",
+            "ERROR: invalid name: ",
+            "ERROR: invalid UTF-8 sequence",
+            "ERROR: element not closed: ",
+            "ERROR: XML Declaration disabled",
+            "ERROR: DOCTYPE disabled",
+            "ERROR: CDATA disabled",
+            "ERROR: Processing Instructions disabled",
+            "ERROR: namespace prefixes disabled"
+        };
+        static_assert(sizeof(messages)/sizeof(*messages) == NamespacesDisabled + 1,
+            "message missing");
+        assert(diagnostic.code <= NamespacesDisabled);
 
-        bool retCode = true;
+        s.assign(messages[diagnostic.code]);
+        if (diagnostic.name.first)
+        {
+            s += '"';
+            s.append(diagnostic.name.first, diagnostic.name.second);
+            s += '"';
+        }
+    }
 
-        // Pointer to unparsed remainder.
-        const char* docPos = doc;
-#ifdef HO_SAX_CATCH_EXCEPTIONS
-        try
-#endif // HO_SAX_CATCH_EXCEPTIONS
+    // Convert to std string an element/attribute name
+    static std::string toStringName(const String& it)
+    {
+        return std::string(it.first, it.second);
+    }
+    // Convert to std string text
+    static std::string toStringText(const String& it)
+    {
+        std::string s;
+        toStringText(it, s);
+        return s;
+    }
+    // Convert to std string CDATA
+    static std::string toStringCdata(const String& it)
+    {
+        std::string s;
+        toStringCdata(it, s);
+        return s;
+    }
+    // Convert to std string an attribute value
+    static std::string toStringValue(const String& it)
+    {
+        std::string s;
+        toStringValue(it, s);
+        return s;
+    }
+    // As above, converting into s; its memory is reused, so there are
+    // no allocations if it has enough capacity (e.g. a buffer reused
+    // for all the documents).
+    static void toStringName(const String& it, std::string& s)
+    {
+        assert(it.first <= it.second);
+        s.assign(it.first, it.second);
+    }
+    static void toStringText(const String& it, std::string& s)
+    {
+        toString(it, true, true, s);
+    }
+    static void toStringCdata(const String& it, std::string& s)
+    {
+        toString(it, true, false, s);
+    }
+    static void toStringValue(const String& it, std::string& s)
+    {
+        toString(it, false, true, s);
+    }
+    // Convert an attribute value or text to a number; surrounding white
+    // spaces are allowed. The syntax doesn't depend on the C locale:
+    // decimal digits with an optional sign; for doubles also a fraction
+    // after '.', an exponent, and INF, -INF, NaN (as in XML Schema).
+    // There are no memory allocations, but for doubles with more than
+    // 40 significant digits.
+    // Return false if it is not a number, or it is out of the type's range.
+    template <typename Int>
+    static bool parseInt(const String& it, Int& value)
+    {
+        static_assert(std::numeric_limits<Int>::is_integer,
+            "integral type expected");
+
+        const String s = trimmed(it);
+        const char* pos = s.first;
+        const bool negative = pos != s.second && *pos == '-';
+        if (pos != s.second && (*pos == '-' || *pos == '+'))
+            ++pos;
+        if (pos == s.second || (negative && !std::numeric_limits<Int>::is_signed))
+            return false;
+
+        // Magnitude of the limit in the value's direction
+        const unsigned long long limit = negative ?
+            static_cast<unsigned long long>(
+                -(static_cast<long long>(std::numeric_limits<Int>::min()) + 1)) + 1 :
+            static_cast<unsigned long long>(std::numeric_limits<Int>::max());
+        unsigned long long v = 0;
+        for (; pos != s.second; ++pos)
         {
-            static const std::string value =
-                "(?:[^<\"]|(?:&(?:lt|gt|amp|apos|quot);))*";
-            // Including optional namespace prefix
-            static const std::string elementName =
-                "(?:" + getReName() + ":)?" + getReName();
-            // Including optional "xml:" prefix for special attributes
-            static const std::string attributeName =
-                "(?:xml:|xmlns:)?" + getReName();
-            // One attribute in the list. Preceded by one or more white spaces!
-            static const std::string attribute =
-                "\\s+(" + attributeName + ")\\s*=\\s*\"(" + value + ")\"";
+            const unsigned digit = static_cast<unsigned char>(*pos) - '0';
+            if (digit > 9 || v > (limit - digit) / 10)
+                return false;
+            v = v * 10 + digit;
+        }
 
-            // At least the 'version' attribute is required
-            static const std::regex regexXmlDeclaration("^<\\?xml(?:\\s+" +
-                getReName() + "\\s*=\\s*\"" + value + "\")+\\s*\\?>");
-            // https://en.wikipedia.org/wiki/Processing_Instruction
-            static const std::regex regexXmlPI("^<\\?(?:" + getReName() +
-                ")(?:\\s+" + getReName() + "\\s*=\\s*\"" +
-                value + "\")*\\s*\\?>");
-            static const std::regex regexXmlCDATA(
-                "^<!\\[CDATA\\[((?:[^\\]]|\\](?!\\]>))*)\\]\\]>");
+        value = !negative ? static_cast<Int>(v) :
+            (v ? static_cast<Int>(-static_cast<long long>(v - 1) - 1) : 0);
+        return true;
+    }
+    static bool parseDouble(const String& it, double& value)
+    {
+        static const char* const specials[] = { "INF", "+INF", "-INF", "NaN" };
 
-            // Non-empty element rules: no spaces are allowed: "< id"
-            static const std::regex regexNodeOpen(
-                "^<(" + elementName + ")(?:" + attribute + ")*\\s*(/)?>");
-            // Closing element rules: no spaces are allowed: "< /id", "</ id"
-            static const std::regex regexNodeClose(
-                "^</(" + elementName + ")\\s*>");
-            static const std::regex regexNodeAttrList("^" + attribute);
+        const String s = trimmed(it);
+        size_t special = 0;
+        if (parseEnum(s, specials, sizeof(specials)/sizeof(*specials), special))
+        {
+            value = special == 3 ? std::numeric_limits<double>::quiet_NaN() :
+                (special == 2 ? -1 : 1) * std::numeric_limits<double>::infinity();
+            return true;
+        }
 
-            docPos = skipSpacesAndComments(docPos);
-            assert(docPos);
+        // [sign] mantissa [exponent]
+        const char* pos = s.first;
+        const bool negative = pos != s.second && *pos == '-';
+        if (pos != s.second && (*pos == '-' || *pos == '+'))
+            ++pos;
+        const char* const mantissa = pos;
+        const char* point = nullptr;
+        size_t digitCount = 0;
+        for (; pos != s.second; ++pos)
+        {
+            if (*pos == '.' && !point)
+                point = pos;
+            else if (isDigit(*pos))
+                ++digitCount;
+            else
+                break;
+        }
+        const char* const mantissaEnd = pos;
+        if (!digitCount)
+            return false;
 
+        long long exponent = 0;
+        if (pos != s.second && (*pos == 'e' || *pos == 'E'))
+        {
+            const bool negativeExponent = ++pos != s.second && *pos == '-';
+            if (pos != s.second && (*pos == '-' || *pos == '+'))
+                ++pos;
+            if (pos == s.second)
+                return false;
+            for (; pos != s.second && isDigit(*pos); ++pos)
             {
-                std::cmatch match;
-                if (std::regex_search(docPos, match, regexXmlDeclaration,
-                        std::regex_constants::match_continuous))
-                {
-                    docPos = skipSpacesAndComments(match.suffix().first);
-                    assert(docPos);
-                }
+                // Beyond the range of double anyway
+                if (exponent < 1000000000)
+                    exponent = exponent * 10 + (*pos - '0');
             }
+            exponent = negativeExponent ? -exponent : exponent;
+        }
+        if (pos != s.second)
+            return false;
 
-            docPos = skipDoctype(docPos);
-            assert(docPos);
+        // strtod() gets the significant digits as an integer, and
+        // the exponent, so no locale specific characters (the point)
+        if (point)
+            exponent -= mantissaEnd - point - 1;
+        const char* first = mantissa;
+        while (first != mantissaEnd && (*first == '0' || *first == '.'))
+            ++first;
+        const char* last = mantissaEnd;
+        for (; last != first && (last[-1] == '0' || last[-1] == '.'); --last)
+            exponent += last[-1] == '0' ? 1 : 0;
+        if (first == last)
+        {
+            value = negative ? -0.0 : 0.0;
+            return true;
+        }
 
-            if (!*docPos)
+        char buffer[64];
+        std::string longBuffer;
+        char* digits = buffer;
+        char* end = buffer + sizeof(buffer);
+        if (last - first > 40)
+        {
+            longBuffer.resize(static_cast<size_t>(last - first) + 24);
+            digits = &longBuffer[0];
+            end = digits + longBuffer.size();
+        }
+        char* out = digits;
+        if (negative)
+            *out++ = '-';
+        for (const char* c = first; c != last; ++c)
+        {
+            if (*c != '.')
+                *out++ = *c;
+        }
+        snprintf(out, static_cast<size_t>(end - out), "e%lld", exponent);
+
+        errno = 0;
+        const double v = strtod(digits, nullptr);
+        if (errno == ERANGE)
+            return false;
+        value = v;
+        return true;
+    }
+    // Accepted values: true, false, 1, 0
+    static bool parseBool(const String& it, bool& value)
+    {
+        return parseBool(it, true, value);
+    }
+    // As above, for a value unescaped already (e.g. by toStringValue())
+    static bool parseUnescapedBool(const String& it, bool& value)
+    {
+        return parseBool(it, false, value);
+    }
+    // Find index of the value in names; the value is compared
+    // as normalized by toStringText(), without memory allocations.
+    // Return false if no name matches.
+    static bool parseEnum(
+        const String& it,
+        const char* const* names,
+        size_t count,
+        size_t& index)
+    {
+        assert(names || !count);
+
+        for (size_t n = 0; n < count; ++n)
+        {
+            if (equalText(it, names[n]))
             {
-                // No XML statements, only some spaces, comments and doctype
-                assert(docPos == (doc + strlen(doc)));
+                index = n;
                 return true;
             }
+        }
+        return false;
+    }
+    // Convert white space separated numbers (e.g. coordinates, matrices)
+    // to the values array.
+    // Return false if a number is invalid, or there are more than capacity
+    // of them; count is the number of converted values.
+    template <typename Number>
+    static bool parseList(
+        const String& it,
+        Number* values,
+        size_t capacity,
+        size_t& count)
+    {
+        assert(it.first <= it.second && (values || !capacity));
 
-            m_nodeStack.clear();
-            do
-            {
-                assert(retCode);
+        count = 0;
+        for (const char* pos = it.first;;)
+        {
+            while (pos != it.second && isspace(static_cast<unsigned char>(*pos)))
+                ++pos;
+            if (pos == it.second)
+                return true;
 
-                const char* tmpPos = nullptr;
-                std::cmatch match;
-                if(std::regex_search(docPos, match, regexNodeOpen,
-                    std::regex_constants::match_continuous))
-                {
-                    assert(!match.empty() && match.size() > 2);
+            const char* const begin = pos;
+            while (pos != it.second && !isspace(static_cast<unsigned char>(*pos)))
+                ++pos;
+            if (count == capacity || !parseNumber(String(begin, pos), values[count]))
+                return false;
+            ++count;
+        }
+    }
+    // Validate UTF-8 encoding of [begin, end): no overlong forms,
+    // surrogates, or code points above U+10FFFF.
+    // Return the position of the first invalid byte, or end.
+    static const char* validateUtf8(const char* begin, const char* end)
+    {
+        assert(begin <= end);
 
-                    const auto lastMatch = match[match.size() - 1];
-                    const bool isEmptyElementTag = lastMatch.matched;
+        const unsigned char* pos = reinterpret_cast<const unsigned char*>(begin);
+        const unsigned char* const last = reinterpret_cast<const unsigned char*>(end);
+        while (pos != last)
+        {
+            // ASCII fast path: 8 bytes at once
+            if (last - pos >= 8)
+            {
+                uint64_t chunk;
+                memcpy(&chunk, pos, sizeof(chunk));
+                if (!(chunk & 0x8080808080808080ULL))
+                {
+                    pos += 8;
+                    continue;
+                }
+            }
 
-                    assert(!isEmptyElementTag || *lastMatch.first == '/');
+            if (*pos < 0x80)
+            {
+                ++pos;
+                continue;
+            }
 
-                    m_nodeStack.push_back(match[1]);
-                    retCode = m_visitor.enter(m_nodeStack.back(), isEmptyElementTag);
+            size_t length = 0;
+            unsigned long min = 0;
+            unsigned long cp = 0;
+            if ((*pos & 0xE0) == 0xC0)
+            {
+                length = 2; min = 0x80; cp = *pos & 0x1F;
+            }
+            else if ((*pos & 0xF0) == 0xE0)
+            {
+                length = 3; min = 0x800; cp = *pos & 0x0F;
+            }
+            else if ((*pos & 0xF8) == 0xF0)
+            {
+                length = 4; min = 0x10000; cp = *pos & 0x07;
+            }
+            else
+            {
+                return reinterpret_cast<const char*>(pos);
+            }
 
-                    std::vector<String> attributeNames;
-                    std::cmatch attrMatch;
-                    for(auto cbegin = match[1].second;
-                        retCode &&
-                        std::regex_search(
-                            cbegin,
-                            match.suffix().first,
-                            attrMatch,
-                            regexNodeAttrList,
-                            std::regex_constants::match_continuous);)
-                    {
-                        assert(attrMatch.size() == 3);
+            if (static_cast<size_t>(last - pos) < length)
+                return reinterpret_cast<const char*>(pos);
+            for (size_t n = 1; n < length; ++n)
+            {
+                if ((pos[n] & 0xC0) != 0x80)
+                    return reinterpret_cast<const char*>(pos);
+                cp = cp << 6 | (pos[n] & 0x3F);
+            }
+            if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+                return reinterpret_cast<const char*>(pos);
 
-                        m_visitor.attribute(attrMatch[1], attrMatch[2]);
+            pos += length;
+        }
+        return end;
+    }
+    // Convert UTF-16 data (recognized by byte order mark, or by '<'
+    // as the first character) to UTF-8.
+    // Return false if data is not UTF-16, or it's invalid.
+    static bool transcodeUtf16(
+        const char* data,
+        size_t size,
+        std::string& out)
+    {
+        assert(data || !size);
 
-                        if (m_visitor.validate())
-                        {
-                            const auto it = std::find_if(
-                                attributeNames.begin(),
-                                attributeNames.end(),
-                                [&](const String& v){
-                                    return equalStrings(attrMatch[1], v);}
-                              );
-                            if (it != attributeNames.end())
-                            {
-                                m_visitor.error(
-                                    ("ERROR: duplicated attribute: \"" + 
-                                    toStringName(*it) + "\"").c_str(), docPos);
-                                retCode = false;
-                            }
-
-                            attributeNames.push_back(attrMatch[1]);
-                        }
-
-                        cbegin = attrMatch.suffix().first;
-                    }
+        const unsigned char* pos = reinterpret_cast<const unsigned char*>(data);
+        if (size < 2 || size % 2)
+            return false;
 
-                    if (retCode && isEmptyElementTag)
-                    {
-                        m_visitor.exit(m_nodeStack.back(), true);
-                        m_nodeStack.pop_back();
-                    }
-                }
-                else if(std::regex_search(docPos, match, regexNodeClose,
-                    std::regex_constants::match_continuous))
-                {
-                    assert(!match.empty());
+        const bool bigEndian =
+            (pos[0] == 0xFE && pos[1] == 0xFF) || (pos[0] == 0 && pos[1] == '<');
+        if ((pos[0] == 0xFE && pos[1] == 0xFF) ||
+            (pos[0] == 0xFF && pos[1] == 0xFE))
+            pos += 2;
+        else if (!bigEndian && (pos[0] != '<' || pos[1] != 0))
+            return false;
 
-                    if(m_nodeStack.empty())
-                    {
-                        m_visitor.error(
-                            "ERROR: no matching opening attribute statement",
-                            docPos);
-                        retCode = false;
-                    }
-                    else
-                    {
-                        if(!equalStrings(m_nodeStack.back(), match[1]))
-                        {
-                            m_visitor.error(
-                                ("ERROR: closing attribute statement mismatch; expected \"" +
-                                toStringName(m_nodeStack.back()) +
-                                "\"").c_str(), docPos);
-                            retCode = false;
-                        }
-                        else
-                        {
-                            retCode = m_visitor.exit(match[1], false);
-                            m_nodeStack.pop_back();
-                        }
-                    }
-                }
-                else if(((tmpPos = strchr(docPos, '<')) > docPos) && tmpPos)
-                {
-                    retCode = m_visitor.text(String(docPos, tmpPos));
-                    docPos = tmpPos;
-                }
-                else if(std::regex_search(
-                    docPos,
-                    match,
-                    regexXmlCDATA,
-                    std::regex_constants::match_continuous))
-                {
-                    assert(!match.empty());
-                    retCode = m_visitor.cdata(match[1]);
-                }
-                else if(std::regex_search(
-                    docPos,
-                    match,
-                    regexXmlPI,
-                    std::regex_constants::match_continuous))
-                { // skip
-                }
-                else
-                {
-                    m_visitor.error(
-                        "ERROR: invalid/unhandled statement or unexpected EOF",
-                        docPos);
-                    retCode = false;
-                }
+        const unsigned char* const end =
+            reinterpret_cast<const unsigned char*>(data) + size;
+        out.clear();
+        out.reserve(size / 2);
 
-                if(retCode)
-                {
-                    assert(!match.empty() || (docPos && *docPos == '<'));
-                    docPos = skipSpacesAndComments(match.empty() ?
-                        docPos : match.suffix().first);
-                    assert(docPos !=
-                        (doc + strlen(doc)) || m_nodeStack.empty());
-                }
-            } while(retCode && !m_nodeStack.empty());
-        }
-#ifdef HO_SAX_CATCH_EXCEPTIONS
-        catch(const std::exception& e)
-        {
-            m_visitor.error(
-                (std::string("ERROR: std::exception ") + e.what()).c_str(),
-                docPos);
-            retCode = false;
-        }
-        catch(...)
+        const auto unit = [&](const unsigned char* p) -> unsigned long
         {
-            m_visitor.error("ERROR: unknown exception", docPos);
-            retCode = false;
-        }
-#endif // HO_SAX_CATCH_EXCEPTIONS
+            return bigEndian ? (p[0] << 8 | p[1]) : (p[1] << 8 | p[0]);
+        };
 
-        return retCode;
-    }
+        for (; pos != end; pos += 2)
+        {
+            unsigned long cp = unit(pos);
+            if (cp >= 0xD800 && cp <= 0xDBFF)
+            {
+                if (end - pos < 4)
+                    return false;
+                const unsigned long low = unit(pos + 2);
+                if (low < 0xDC00 || low > 0xDFFF)
+                    return false;
+                cp = 0x10000 + ((cp - 0xD800) << 10 | (low - 0xDC00));
+                pos += 2;
+            }
+            else if (cp >= 0xDC00 && cp <= 0xDFFF)
+            {
+                return false;
+            }
 
-    // Convert to std string an element/attribute name
-    static std::string toStringName(const String& it)
-    {
-        return toString(it, false, true);
-    }
-    // Convert to std string text
-    static std::string toStringText(const String& it)
-    {
-        return fixEscapes(toString(it, true, true));
-    }
-    // Convert to std string CDATA
-    static std::string toStringCdata(const String& it)
-    {
-        return toString(it, true, true);
-    }
-    // Convert to std string an attribute value
-    static std::string toStringValue(const String& it)
-    {
-        return fixEscapes(toString(it, true, false));
+            if (cp < 0x80)
+            {
+                out += static_cast<char>(cp);
+            }
+            else if (cp < 0x800)
+            {
+                out += static_cast<char>(0xC0 | cp >> 6);
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+            else if (cp < 0x10000)
+            {
+                out += static_cast<char>(0xE0 | cp >> 12);
+                out += static_cast<char>(0x80 | (cp >> 6 & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+            else
+            {
+                out += static_cast<char>(0xF0 | cp >> 18);
+                out += static_cast<char>(0x80 | (cp >> 12 & 0x3F));
+                out += static_cast<char>(0x80 | (cp >> 6 & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+        }
+        return true;
     }
     // Obtain (row, col) pair of current position in C-string
     // Assume that '\r' not followed by '\n' means new line,
@@ -402,56 +674,319 @@ public: // function members
         pos.second = 1 + static_cast<size_t>(docPos - last);
         return pos;
     }
-
-private: // functions
-    static const std::string& getReName()
+    // Length of the predefined entity's reference at pos (right after its
+    // '&', e.g. "amp;"), not exceeding end; c is set to the character
+    // the entity stands for. Return 0 if there is no such reference.
+    static size_t unescape(const char* pos, const char* end, char& c)
     {
-        static const std::string name = "[a-zA-Z_][\\w\\.\\-]*";
-        return name;
+        assert(pos <= end);
+
+        static const char* const entities[] = {
+            "lt;", "<", "gt;", ">", "amp;", "&", "apos;", "'", "quot;", "\"" };
+
+        for (size_t n = 0; n < sizeof(entities)/sizeof(*entities); n += 2)
+        {
+            const size_t length = strlen(entities[n]);
+            if (static_cast<size_t>(end - pos) >= length &&
+                !strncmp(pos, entities[n], length))
+            {
+                c = *entities[n + 1];
+                return length;
+            }
+        }
+        return 0;
     }
 
-    static const std::string& getReComment()
+    // FNV-1a hash of [begin, end) character sequence; pass the previous
+    // result as a seed to hash multiple sequences
+    static uint64_t hash(
+        const String& it,
+        uint64_t seed = 14695981039346656037ULL)
     {
-        static const std::string comment = "(?:<!--(?:(?:[^-]|-(?!->))*)-->)";
-        return comment;
+        assert(it.first <= it.second);
+
+        for (const char* pos = it.first; pos != it.second; ++pos)
+        {
+            seed ^= static_cast<unsigned char>(*pos);
+            seed *= 1099511628211ULL;
+        }
+        return seed;
     }
 
-    const char* skipSpacesAndComments(const char* docPos)
+protected: // types
+    // Names of the open elements, and the beginnings of their content,
+    // with inline storage for typical depths
+    class NodeStack
     {
-        static const std::regex spacesAndComments(
-            "^(?:\\s+|\\s*" + getReComment() + "\\s*)+");
-        std::cmatch match;
-        if (std::regex_search(docPos, match, spacesAndComments,
-                std::regex_constants::match_continuous))
+    public:
+        NodeStack():
+            m_size(0)
+        {}
+
+        bool empty() const
         {
-            docPos = match.suffix().first;
+            return !m_size;
         }
-        return docPos;
-    }
 
-    const char* skipDoctype(const char* docPos)
-    {
-        static const std::string id = "(?:\\w|#|-|,|\\(|\\)|\\*|\\?|\\+|\\|)+";
-        static const std::string element =
-            "(?:<!(?:ELEMENT|ATTLIST|NOTATION|ENTITY)\\s+"
-            "(?:(?:" + id + "\\s*)|(?:\\\".*\\\"\\s*))+>)";
-        static const std::regex regexDoctype(std::string("^<!DOCTYPE\\s+") +
-            getReName() + "\\s*\\[" +
-            "(?:" + getReComment() + "|" + element + "|\\s*)+" +
-            "\\s*\\]>"
-            );
-        
-        std::cmatch match;
-        if (std::regex_search(docPos, match, regexDoctype,
-                std::regex_constants::match_continuous))
+        size_t size() const
         {
-            docPos = skipSpacesAndComments(match.suffix().first);
+            return m_size;
         }
 
-        return docPos;
-    }
+        void clear()
+        {
+            m_size = 0;
+            m_overflow.clear();
+        }
 
-    static bool equalStrings(
+        void push_back(const String& name, const char* content)
+        {
+            const Node node = { name, content };
+            if (m_size < InlineSize)
+                m_inline[m_size] = node;
+            else
+                m_overflow.push_back(node);
+            ++m_size;
+        }
+
+        void pop_back()
+        {
+            assert(m_size);
+            if (--m_size >= InlineSize)
+                m_overflow.pop_back();
+        }
+
+        const String& back() const
+        {
+            return (*this)[m_size - 1];
+        }
+
+        const String& operator[](size_t index) const
+        {
+            return node(index).name;
+        }
+
+        // Beginning of the content of the innermost element
+        const char* content() const
+        {
+            return node(m_size - 1).content;
+        }
+
+    private:
+        enum { InlineSize = 32 };
+
+        struct Node
+        {
+            String name;
+            const char* content;
+        };
+
+        const Node& node(size_t index) const
+        {
+            assert(index < m_size);
+            return index < InlineSize ? m_inline[index] : m_overflow[index - InlineSize];
+        }
+
+        Node m_inline[InlineSize];
+        std::vector<Node> m_overflow;
+        size_t m_size;
+    };
+
+protected: // functions
+    // Lightweight scan for the end of the element starting at pos,
+    // tracking the nesting depth only (not checking names, nor syntax).
+    // Return position right after the element, or nullptr if the input
+    // ends before.
+    static const char* scanElementEnd(const char* pos)
+    {
+        size_t depth = 0;
+        while ((pos = strchr(pos, '<')) != nullptr)
+        {
+            const char* end = nullptr;
+            if (!strncmp(pos, "<!--", 4))
+            {
+                end = strstr(pos + 4, "-->");
+                pos = end ? end + 3 : nullptr;
+            }
+            else if (!strncmp(pos, "<![CDATA[", 9))
+            {
+                end = strstr(pos + 9, "]]>");
+                pos = end ? end + 3 : nullptr;
+            }
+            else if (!strncmp(pos, "<!DOCTYPE", 9))
+            {
+                // The internal subset contains '>', see parseDoctype()
+                const char* const subset = strpbrk(pos, "[>");
+                end = subset && *subset == '[' ? strstr(subset, "]>") : subset;
+                pos = end ? end + (*end == ']' ? 2 : 1) : nullptr;
+            }
+            else if (pos[1] == '!')
+            {
+                end = strchr(pos + 2, '>');
+                pos = end ? end + 1 : nullptr;
+            }
+            else if (pos[1] == '?')
+            {
+                end = strstr(pos + 2, "?>");
+                pos = end ? end + 2 : nullptr;
+            }
+            else
+            {
+                const bool isClosing = pos[1] == '/';
+                char quote = 0;
+                for (end = pos + 1; *end && (quote || *end != '>'); ++end)
+                {
+                    if (quote)
+                        quote = *end == quote ? 0 : quote;
+                    else if (*end == '"' || *end == '\'')
+                        quote = *end;
+                }
+                if (!*end)
+                    return nullptr;
+
+                if (isClosing)
+                    depth -= depth ? 1 : 0;
+                else if (end[-1] != '/')
+                    ++depth;
+
+                pos = end + 1;
+                if (!depth)
+                    return pos;
+            }
+
+            if (!pos)
+                return nullptr;
+        }
+        return nullptr;
+    }
+
+    // Check if the tag at pos has a prefixed name (of the element,
+    // or of an attribute, but for the reserved "xml:", "xmlns:")
+    static bool hasPrefix(const char* pos)
+    {
+        const char* const element = pos + 1;
+        const char* name = element;
+        for (bool quoted = false; *pos && (quoted || *pos != '>'); ++pos)
+        {
+            if (*pos == '"')
+                quoted = !quoted;
+            else if (!quoted && isspace(static_cast<unsigned char>(*pos)))
+                name = pos + 1;
+            else if (!quoted && *pos == ':' &&
+                (name == element || !isReservedPrefix(String(name, pos))))
+                return true;
+        }
+        return false;
+    }
+
+    static bool isReservedPrefix(const String& prefix)
+    {
+        const size_t length = static_cast<size_t>(prefix.second - prefix.first);
+        return (length == 3 && !strncmp(prefix.first, "xml", 3)) ||
+            (length == 5 && !strncmp(prefix.first, "xmlns", 5));
+    }
+
+    static const std::string& getReName(bool utf8)
+    {
+        static const std::string name = "[a-zA-Z_][\\w\\.\\-]*";
+        // Non-ASCII (UTF-8) bytes are accepted here, see checkName()
+        static const std::string utf8Name =
+            "[a-zA-Z_\x80-\xff][\\w\\.\\-\x80-\xff]*";
+        return utf8 ? utf8Name : name;
+    }
+
+    static const std::string& getReComment()
+    {
+        static const std::string comment = "(?:<!--(?:(?:[^-]|-(?!->))*)-->)";
+        return comment;
+    }
+
+    // [begin, end) sequence without surrounding white spaces
+    static String trimmed(const String& it)
+    {
+        assert(it.first <= it.second);
+
+        const char* begin = it.first;
+        const char* end = it.second;
+        while (begin != end && isspace(static_cast<unsigned char>(*begin)))
+            ++begin;
+        while (begin != end && isspace(static_cast<unsigned char>(end[-1])))
+            --end;
+        return String(begin, end);
+    }
+
+    // Decimal digit, regardless of the C locale
+    static bool isDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    template <typename Int>
+    static bool parseNumber(const String& it, Int& value)
+    {
+        return parseInt(it, value);
+    }
+    static bool parseNumber(const String& it, double& value)
+    {
+        return parseDouble(it, value);
+    }
+    static bool parseNumber(const String& it, float& value)
+    {
+        double v = 0;
+        if (!parseDouble(it, v))
+            return false;
+        value = static_cast<float>(v);
+        return true;
+    }
+
+    static bool parseBool(const String& it, bool unescape, bool& value)
+    {
+        static const char* const names[] = { "false", "true", "0", "1" };
+        for (size_t n = 0; n < sizeof(names)/sizeof(*names); ++n)
+        {
+            if (equalText(it, names[n], unescape))
+            {
+                value = n % 2 != 0;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Compare [begin, end) normalized as text (see toString()), or only
+    // its white spaces if !unescape, with a C-string
+    static bool equalText(const String& it, const char* s, bool unescape = true)
+    {
+        assert(it.first <= it.second && s);
+
+        const char* pos = it.first;
+        while (pos != it.second && isspace(static_cast<unsigned char>(*pos)))
+            ++pos;
+
+        while (pos != it.second)
+        {
+            if (isspace(static_cast<unsigned char>(*pos)))
+            {
+                while (pos != it.second && isspace(static_cast<unsigned char>(*pos)))
+                    ++pos;
+                if (pos == it.second)
+                    break;
+                if (*s++ != ' ')
+                    return false;
+                continue;
+            }
+
+            char c = *pos++;
+            if (c == '&' && unescape)
+                pos += XmlSaxBase::unescape(pos, it.second, c);
+            if (*s++ != c)
+                return false;
+        }
+
+        return !*s;
+    }
+
+    static bool equalStrings(
         const String& s1,
         const String& s2)
     {
@@ -463,76 +998,777 @@ private: // functions
             !std::strncmp(s1.first, s2. first, static_cast<size_t>(length1));
     }
 
-    static std::string fixEscapes(std::string&& s)
-    {
-        struct Esc {
-            std::regex r;
-            std::string str; };
-        static const Esc esc[] = {
-            { std::regex("&lt;"), "<" },
-            { std::regex("&gt;"), ">" },
-            { std::regex("&amp;"), "&", },
-            { std::regex("&apos;"), "'" },
-            { std::regex("&quot;"), "\"" } };
-
-        std::for_each(esc, esc + sizeof(esc)/sizeof(*esc),
-            [&s](const Esc& esc){
-                s = std::regex_replace(s, esc.r, esc.str);});
-
-        return s;
-    }
-
-    // Convert [begin, end) character sequence to std string
+    // Convert [begin, end) character sequence to std string s
     // Normalization rules:
     // * value: space sequence -> one space
     // * text, CDATA: space sequence -> one space;
     //   remove surrounding spaces;
-    static std::string toString(
+    // * text, value: escape codes of the predefined entities are replaced
+    static void toString(
         const String& it,
-        bool normalize,
-        bool removeSurrSpaces)
+        bool removeSurrSpaces,
+        bool unescape,
+        std::string& s)
     {
         assert(it.first && it.second && it.first <= it.second);
 
-        if (!normalize)
-            return std::string(it.first, it.second);
+        s.clear();
+        const char* pos = it.first;
+        while (pos != it.second)
+        {
+            if (isspace(static_cast<unsigned char>(*pos)))
+            {
+                const bool leading = pos == it.first;
+                while (pos != it.second && isspace(static_cast<unsigned char>(*pos)))
+                    ++pos;
+                if (!removeSurrSpaces || (!leading && pos != it.second))
+                    s += ' ';
+                continue;
+            }
+
+            if (*pos == '&' && unescape)
+            {
+                char c = 0;
+                const size_t length = XmlSaxBase::unescape(pos + 1, it.second, c);
+                if (length)
+                {
+                    s += c;
+                    pos += 1 + length;
+                    continue;
+                }
+            }
+
+            // Copy the run of ordinary characters at once
+            const char* const begin = pos++;
+            while (pos != it.second && *pos != '&' &&
+                !isspace(static_cast<unsigned char>(*pos)))
+                ++pos;
+            s.append(begin, pos);
+        }
+    }
+
+};
+
+/// The parser of the Features (see xmlsax::Feature) grammar
+template <unsigned Features = xmlsax::AllFeatures>
+class XmlSaxParser : public XmlSaxBase
+{
+public: // constructors
+    XmlSaxParser(Visitor& visitor):
+        m_visitor(visitor),
+        m_errorPos(nullptr),
+        m_diagnostics(nullptr),
+        m_checkUtf8(false),
+        m_validated(nullptr)
+    {}
+
+public: // function members
+    // Parsing method; doc refers to a C-style string representing xml document
+    // Return false if parsing process failed, or a callback function
+    // returned false.
+    bool parse(const char* doc)
+    {
+        m_diagnostics = nullptr;
+        return parseDocument(doc, false, false, nullptr);
+    }
+
+    // Parse the document reporting all its errors at once: each error is
+    // stored in diagnostics (instead of calling Visitor::error()), and
+    // parsing continues:
+    // * an invalid statement is skipped up to the next '<'
+    // * a closing tag of an element open higher in the tree closes
+    //   the elements above it (exit() is called for them); other
+    //   unbalanced closing tags are skipped
+    // * elements open at the end of the document are closed
+    // So the visitor gets balanced enter()/exit() events, as for a valid
+    // document. Exceptions (see HO_SAX_CATCH_EXCEPTIONS) are still passed
+    // to Visitor::error(), and stop parsing.
+    // Valid documents are parsed as by parse().
+    // Return false if any error was found, or a callback function
+    // returned false.
+    bool lint(const char* doc, Diagnostics& diagnostics)
+    {
+        diagnostics.clear();
+        m_diagnostics = &diagnostics;
+        const bool retCode = parseDocument(doc, false, false, nullptr);
+        m_diagnostics = nullptr;
+        return retCode && diagnostics.empty();
+    }
+
+    // Parse a stream of concatenated fragments (root elements), e.g. a log;
+    // XML Declarations and PIs between the fragments are skipped.
+    // Visitor::fragment() is called after each parsed fragment.
+    // recover: after a parse error continue with the next fragment; elements
+    //   open in the failed fragment are abandoned (exit() is not called).
+    // remainder: if not null, doc may end with an incomplete fragment,
+    //   e.g. when it is a chunk of a bigger input; such fragment is not
+    //   parsed (no events for it), and remainder is set to its beginning
+    //   (or to the end of doc), so the client may append more data to it
+    //   and continue from there; remainder is not set if parsing has been
+    //   stopped (by an error without recovery, or by a callback function).
+    // Return false if parsing of any fragment failed, or a callback function
+    // returned false.
+    bool parseFragments(
+        const char* doc,
+        bool recover = false,
+        const char** remainder = nullptr)
+    {
+        m_diagnostics = nullptr;
+        return parseDocument(doc, true, recover, remainder);
+    }
 
-        static const std::regex regexTrimmed(
-            "(\\s+)?(\\S+(?:\\s+\\S+)*)?(\\s+)?");
-        std::cmatch match;
-        if (std::regex_match(it.first, it.second, match, regexTrimmed,
+private: // types
+    // Regular expressions of the enabled features only; the others
+    // are empty (not compiled)
+    struct Grammar
+    {
+        std::regex xmlDeclaration;
+        std::regex xmlPI;
+        std::regex xmlCDATA;
+        std::regex doctype;
+        std::regex nodeOpen;
+        std::regex nodeClose;
+        std::regex nodeAttrList;
+    };
+
+private: // functions
+    static bool enabled(xmlsax::Feature feature)
+    {
+        return (Features & feature) != 0;
+    }
+
+    // Grammar of names with non-ASCII characters if utf8
+    static const Grammar& getGrammar(bool utf8)
+    {
+        if (utf8)
+        {
+            static const Grammar grammar = makeGrammar(true);
+            return grammar;
+        }
+        static const Grammar grammar = makeGrammar(false);
+        return grammar;
+    }
+
+    static Grammar makeGrammar(bool utf8)
+    {
+        const std::string value =
+            "(?:[^<\"]|(?:&(?:lt|gt|amp|apos|quot);))*";
+        const std::string& name = getReName(utf8);
+        // Including optional namespace prefix
+        const std::string elementName = enabled(xmlsax::Namespaces) ?
+            "(?:" + name + ":)?" + name : name;
+        // Including optional prefix; without namespaces only the reserved
+        // ones, "xml:", "xmlns:"
+        const std::string attributeName = enabled(xmlsax::Namespaces) ?
+            elementName : "(?:xml:|xmlns:)?" + name;
+        // One attribute in the list. Preceded by one or more white spaces!
+        const std::string attribute =
+            "\\s+(" + attributeName + ")\\s*=\\s*\"(" + value + ")\"";
+
+        Grammar grammar;
+        if (enabled(xmlsax::XmlDeclaration))
+        {
+            // At least the 'version' attribute is required
+            grammar.xmlDeclaration = std::regex("^<\\?xml(?:\\s+" +
+                name + "\\s*=\\s*\"" + value + "\")+\\s*\\?>");
+        }
+        if (enabled(xmlsax::Pi))
+        {
+            // https://en.wikipedia.org/wiki/Processing_Instruction
+            grammar.xmlPI = std::regex("^<\\?(?:" + name +
+                ")(?:\\s+" + name + "\\s*=\\s*\"" +
+                value + "\")*\\s*\\?>");
+        }
+        if (enabled(xmlsax::Cdata))
+        {
+            grammar.xmlCDATA = std::regex(
+                "^<!\\[CDATA\\[((?:[^\\]]|\\](?!\\]>))*)\\]\\]>");
+        }
+        if (enabled(xmlsax::Doctype))
+        {
+            const std::string id = "(?:\\w|#|-|,|\\(|\\)|\\*|\\?|\\+|\\|)+";
+            const std::string declaration =
+                "(?:<!(?:ELEMENT|ATTLIST|NOTATION|ENTITY)\\s+"
+                "(?:(?:" + id + "\\s*)|(?:\\\".*\\\"\\s*))+>)";
+            grammar.doctype = std::regex("^<!DOCTYPE\\s+" + name + "\\s*\\[" +
+                "((?:" + getReComment() + "|" + declaration + "|\\s*)+)" +
+                "\\s*\\]>");
+        }
+        // Non-empty element rules: no spaces are allowed: "< id"
+        grammar.nodeOpen = std::regex(
+            "^<(" + elementName + ")(?:" + attribute + ")*\\s*(/)?>");
+        // Closing element rules: no spaces are allowed: "< /id", "</ id"
+        grammar.nodeClose = std::regex(
+            "^</(" + elementName + ")\\s*>");
+        grammar.nodeAttrList = std::regex("^" + attribute);
+        return grammar;
+    }
+
+    bool parseDocument(
+        const char* doc,
+        bool fragments,
+        bool recover,
+        const char** remainder)
+    {
+        assert(doc);
+
+        bool retCode = true;
+        m_errorPos = nullptr;
+
+        // Pointer to unparsed remainder.
+        const char* docPos = doc;
+        const bool utf8 = m_visitor.utf8();
+        m_checkUtf8 = utf8;
+        m_validated = doc;
+#ifdef HO_SAX_CATCH_EXCEPTIONS
+        try
+#endif // HO_SAX_CATCH_EXCEPTIONS
+        {
+            // UTF-8 byte order mark
+            if (!strncmp(docPos, "\xEF\xBB\xBF", 3))
+                docPos += 3;
+
+            docPos = skipSpacesAndComments(docPos);
+            assert(docPos);
+
+            if (enabled(xmlsax::XmlDeclaration))
+            {
+                std::cmatch match;
+                if (std::regex_search(docPos, match, getGrammar(utf8).xmlDeclaration,
+                        std::regex_constants::match_continuous))
+                {
+                    docPos = skipSpacesAndComments(match.suffix().first);
+                    assert(docPos);
+                }
+            }
+            else if (!strncmp(docPos, "<?xml", 5) &&
+                isspace(static_cast<unsigned char>(docPos[5])))
+            {
+                if (!reportError(XmlDeclarationDisabled, docPos))
+                    return false;
+                docPos = skipStatement(docPos, "?>");
+            }
+
+            if (!parseDoctype(docPos, utf8))
+                return false;
+            assert(docPos);
+
+            if (fragments)
+            {
+                retCode = parseFragmentList(docPos, utf8, recover, remainder);
+            }
+            else if (!*docPos)
+            {
+                // No XML statements, only some spaces, comments and doctype
+                assert(docPos == (doc + strlen(doc)));
+                return checkUtf8(docPos);
+            }
+            else
+            {
+                retCode = parseElement(docPos, utf8);
+            }
+        }
+#ifdef HO_SAX_CATCH_EXCEPTIONS
+        catch(const std::exception& e)
+        {
+            reportError(
+                (std::string("ERROR: std::exception ") + e.what()).c_str(),
+                docPos);
+            retCode = false;
+        }
+        catch(...)
+        {
+            reportError("ERROR: unknown exception", docPos);
+            retCode = false;
+        }
+#endif // HO_SAX_CATCH_EXCEPTIONS
+
+        return retCode;
+    }
+
+    // Parse one element (with its subtree) starting at docPos;
+    // on success docPos points right after the element
+    bool parseElement(const char*& docPos, bool utf8)
+    {
+        const Grammar& grammar = getGrammar(utf8);
+        bool retCode = true;
+        // In lint mode errors don't stop parsing, see lint()
+        const bool lint = m_diagnostics != nullptr;
+        const bool spans = m_visitor.spans();
+        // In lint mode, the root element may follow skipped statements
+        // (otherwise events are the same as without lint mode)
+        bool rooted = false;
+
+        // Match results are reused, to not allocate their memory again
+        std::cmatch& match = m_match;
+        std::cmatch& attrMatch = m_attrMatch;
+
+        m_nodeStack.clear();
+        do
+        {
+            assert(retCode);
+
+            // Dispatch by the first characters, so only the regex
+            // of the possible statement is tried
+            const char* next = nullptr;
+            ErrorCode unhandled = InvalidStatement;
+            if(*docPos != '<')
+            {
+                next = strchr(docPos, '<');
+                if(next)
+                    retCode = checkUtf8(next) && m_visitor.text(String(docPos, next));
+            }
+            else if(docPos[1] == '/')
+            {
+                if(std::regex_search(docPos, match, grammar.nodeClose,
+                    std::regex_constants::match_continuous))
+                {
+                    assert(!match.empty());
+
+                    if(!checkUtf8(match.suffix().first))
+                    {
+                        retCode = false;
+                    }
+                    else if(m_nodeStack.empty())
+                    {
+                        retCode = reportError(UnmatchedClosingTag, docPos);
+                    }
+                    else if(!equalStrings(m_nodeStack.back(), match[1]))
+                    {
+                        retCode = reportError(
+                            MismatchedClosingTag, docPos, m_nodeStack.back()) &&
+                            closeUntil(match[1], docPos, match.suffix().first, spans);
+                    }
+                    else
+                    {
+                        retCode = (!spans ||
+                            span(docPos, match.suffix().first)) &&
+                            m_visitor.exit(match[1], false);
+                        m_nodeStack.pop_back();
+                    }
+                    next = match.suffix().first;
+                }
+            }
+            else if(docPos[1] == '!')
+            {
+                if(!enabled(xmlsax::Cdata))
+                {
+                    if(!strncmp(docPos, "<![CDATA[", 9))
+                        unhandled = CdataDisabled;
+                }
+                else if(std::regex_search(
+                    docPos,
+                    match,
+                    grammar.xmlCDATA,
+                    std::regex_constants::match_continuous))
+                {
+                    assert(!match.empty());
+                    retCode = checkUtf8(match.suffix().first) &&
+                        m_visitor.cdata(match[1]);
+                    next = match.suffix().first;
+                }
+            }
+            else if(docPos[1] == '?')
+            {
+                if(!enabled(xmlsax::Pi))
+                {
+                    unhandled = PiDisabled;
+                }
+                else if(std::regex_search(
+                    docPos,
+                    match,
+                    grammar.xmlPI,
+                    std::regex_constants::match_continuous))
+                { // skip
+                    retCode = checkUtf8(match.suffix().first);
+                    next = match.suffix().first;
+                }
+            }
+            else if(std::regex_search(docPos, match, grammar.nodeOpen,
                 std::regex_constants::match_continuous))
+            {
+                assert(!match.empty() && match.size() > 2);
+
+                const auto lastMatch = match[match.size() - 1];
+                const bool isEmptyElementTag = lastMatch.matched;
+
+                assert(!isEmptyElementTag || *lastMatch.first == '/');
+
+                retCode = checkUtf8(match.suffix().first) &&
+                    (!m_checkUtf8 || checkName(match[1], docPos));
+                if (retCode)
+                {
+                    rooted = true;
+                    m_nodeStack.push_back(match[1], match.suffix().first);
+                    retCode = m_visitor.enter(m_nodeStack.back(), isEmptyElementTag);
+                }
+
+                m_attributeNames.clear();
+                for(auto cbegin = match[1].second;
+                    retCode &&
+                    std::regex_search(
+                        cbegin,
+                        match.suffix().first,
+                        attrMatch,
+                        grammar.nodeAttrList,
+                        std::regex_constants::match_continuous);)
+                {
+                    assert(attrMatch.size() == 3);
+
+                    retCode = (!m_checkUtf8 || checkName(attrMatch[1], docPos)) &&
+                        m_visitor.attribute(attrMatch[1], attrMatch[2]);
+
+                    if (retCode && m_visitor.validate())
+                    {
+                        const auto it = std::find_if(
+                            m_attributeNames.begin(),
+                            m_attributeNames.end(),
+                            [&](const String& v){
+                                return equalStrings(attrMatch[1], v);}
+                          );
+                        if (it != m_attributeNames.end())
+                            retCode = reportError(DuplicatedAttribute, docPos, *it);
+
+                        m_attributeNames.push_back(attrMatch[1]);
+                    }
+
+                    cbegin = attrMatch.suffix().first;
+                }
+
+                if (retCode && isEmptyElementTag)
+                {
+                    retCode = (!spans ||
+                        span(match.suffix().first, match.suffix().first)) &&
+                        m_visitor.exit(m_nodeStack.back(), true);
+                    m_nodeStack.pop_back();
+                }
+
+                next = match.suffix().first;
+            }
+            else if(!enabled(xmlsax::Namespaces) && hasPrefix(docPos))
+            {
+                unhandled = NamespacesDisabled;
+            }
+
+            if(!next && retCode)
+            {
+                retCode = reportError(unhandled, docPos);
+                // Resynchronize at the next tag, or close the open elements
+                // at the end of the document
+                next = retCode && *docPos ? strchr(docPos + 1, '<') : nullptr;
+                if(retCode && !next)
+                {
+                    next = docPos + strlen(docPos);
+                    retCode = closeUntil(String(nullptr, nullptr), next, next, spans);
+                }
+            }
+
+            if(retCode)
+            {
+                assert(next);
+                docPos = next;
+                // Stop right after the element, e.g. for fragment's span
+                if (!m_nodeStack.empty())
+                    docPos = skipSpacesAndComments(docPos);
+            }
+        } while(retCode && (!m_nodeStack.empty() ||
+            (lint && !rooted && !m_diagnostics->empty() && *docPos)));
+
+        return retCode;
+    }
+
+    // Lint mode repair of a closing tag not matching the innermost open
+    // element: close the elements up to the one of given name, or
+    // all of them for (nullptr, nullptr); the tag is skipped if no open
+    // element has the name.
+    // [tag, tagEnd) is the closing tag: the end of the matching element,
+    // and the end of the content of the ones above it.
+    // Return false if stopped by a callback, or by an error.
+    bool closeUntil(
+        const String& name,
+        const char* tag,
+        const char* tagEnd,
+        bool spans)
+    {
+        assert(m_diagnostics);
+
+        size_t depth = 0;
+        if (name.first)
         {
-            assert(!(!match[1].matched && !match[2].matched && match[3].matched) &&
-                "Unexpected match, seen on VS2010");
+            depth = m_nodeStack.size();
+            while (depth && !equalStrings(m_nodeStack[depth - 1], name))
+                --depth;
+            if (!depth)
+                return true;
+            --depth;
+        }
+
+        while (m_nodeStack.size() > depth)
+        {
+            const String element = m_nodeStack.back();
+            if (!name.first &&
+                !reportError(UnclosedElement, element.first - 1, element))
+                return false;
+            const bool matching = m_nodeStack.size() == depth + 1 && name.first;
+            if (spans && !span(tag, matching ? tagEnd : tag))
+                return false;
+            m_nodeStack.pop_back();
+            if (!m_visitor.exit(element, false))
+                return false;
+        }
+        return true;
+    }
+
+    // Pass the spans of the innermost element, whose content ends
+    // at contentEnd, and the end tag at end.
+    // Return false if stopped by the span() callback.
+    bool span(const char* contentEnd, const char* end)
+    {
+        const String& element = m_nodeStack.back();
+        // The start tag's '<' precedes the name
+        return m_visitor.span(element,
+            String(element.first - 1, end),
+            String(m_nodeStack.content(), contentEnd));
+    }
+
+    bool parseFragmentList(
+        const char*& docPos,
+        bool utf8,
+        bool recover,
+        const char** remainder)
+    {
+        bool retCode = true;
+
+        for (;;)
+        {
+            std::cmatch match;
+            while (enabled(xmlsax::Pi) &&
+                std::regex_search(docPos, match, getGrammar(utf8).xmlPI,
+                    std::regex_constants::match_continuous))
+            {
+                docPos = skipSpacesAndComments(match.suffix().first);
+            }
+
+            // Each fragment may have its document type declaration
+            m_errorPos = nullptr;
+            if (!parseDoctype(docPos, utf8))
+            {
+                // Stopped by a callback, or by an error
+                if (!m_errorPos || !recover)
+                    return false;
+                retCode = false;
+            }
+
+            if (!*docPos)
+                break;
 
-            const String trimmed = std::make_pair(
-                !removeSurrSpaces && match[1].matched ?
-                    match[1].second - 1 :
-                    (match[2].matched ? match[2].first : it.second),
-                !removeSurrSpaces && match[3].matched ?
-                    match[3].first + 1 :
-                    (match[2].matched ? match[2].second : it.second));
+            const char* const begin = docPos;
+            if (remainder && !scanElementEnd(begin))
+                break;
 
-            std::string s;
-            std::regex_replace(
-                std::back_inserter(s),
-                trimmed.first,
-                trimmed.second,
-                std::regex("\\s+"),
-                std::string(" "));
+            m_errorPos = nullptr;
+            bool parsed = false;
+            if (*docPos == '<')
+            {
+                parsed = parseElement(docPos, utf8);
+            }
+            else
+            {
+                reportError(InvalidStatement, docPos);
+            }
 
-            return s;
+            if (parsed)
+            {
+                if (!m_visitor.fragment(String(begin, docPos)))
+                    return false;
+            }
+            else if (!m_errorPos || !recover)
+            {
+                // Stopped by a callback, or by an error
+                return false;
+            }
+            else
+            {
+                retCode = false;
+                // Resume after the failed fragment
+                const char* const end =
+                    *begin == '<' ? scanElementEnd(begin) : nullptr;
+                if (end && end > m_errorPos)
+                {
+                    docPos = end;
+                }
+                else
+                {
+                    docPos = *m_errorPos ? strchr(m_errorPos + 1, '<') : nullptr;
+                    if (!docPos)
+                        docPos = m_errorPos + strlen(m_errorPos);
+                }
+                // The rest of the failed fragment is not validated
+                m_validated = std::max(m_validated, docPos);
+            }
+
+            docPos = skipSpacesAndComments(docPos);
         }
-        
-        return std::string(it.first, it.second);
+
+        if (remainder)
+            *remainder = docPos;
+
+        return retCode;
+    }
+
+    void reportError(const char* info, const char* docPos)
+    {
+        m_errorPos = docPos;
+        m_visitor.error(info, docPos);
+    }
+
+    // Report the error to the visitor, or store it in lint mode.
+    // Return true if parsing should continue (lint mode).
+    bool reportError(
+        ErrorCode code,
+        const char* docPos,
+        const String& name = String(nullptr, nullptr))
+    {
+        const Diagnostic diagnostic = { code, docPos, name };
+        m_errorPos = docPos;
+        if (m_diagnostics)
+        {
+            m_diagnostics->push_back(diagnostic);
+            return true;
+        }
+
+        describe(diagnostic, m_errorInfo);
+        m_visitor.error(m_errorInfo.c_str(), docPos);
+        return false;
+    }
+
+    // Validate UTF-8 encoding of the input up to end, if the visitor asks
+    // for it; the input is validated once, as the parser consumes it, so
+    // an incomplete fragment (see parseFragments()) isn't.
+    // Return false if the input is invalid (and not in lint mode).
+    bool checkUtf8(const char* end)
+    {
+        if (!m_checkUtf8 || end <= m_validated)
+            return true;
+
+        const char* const invalid = validateUtf8(m_validated, end);
+        m_validated = end;
+        if (invalid == end)
+            return true;
+
+        // Lint mode: names can't be checked in invalid input
+        m_checkUtf8 = false;
+        return reportError(InvalidUtf8, invalid);
+    }
+
+    // Position right after the end sequence of the statement at docPos,
+    // or the end of the document
+    const char* skipStatement(const char* docPos, const char* end)
+    {
+        const char* const pos = strstr(docPos, end);
+        return skipSpacesAndComments(pos ? pos + strlen(end) : docPos + strlen(docPos));
+    }
+
+    // Check non-ASCII characters of a name matched with getReName(true)
+    // against XML Name rules; ASCII ones are already checked by the regex.
+    // Input is valid UTF-8.
+    // Return false if the name is invalid (and not in lint mode).
+    bool checkName(const String& name, const char* docPos)
+    {
+        for (const char* pos = name.first; pos != name.second;)
+        {
+            const unsigned char c = static_cast<unsigned char>(*pos);
+            if (c < 0x80)
+            {
+                ++pos;
+                continue;
+            }
+
+            const bool isStart = pos == name.first || pos[-1] == ':';
+            const size_t length = c >= 0xF0 ? 4 : (c >= 0xE0 ? 3 : 2);
+            unsigned long cp = c & (0x7F >> length);
+            for (size_t n = 1; n < length; ++n)
+                cp = cp << 6 | (static_cast<unsigned char>(pos[n]) & 0x3F);
+            pos += length;
+
+            const bool isNameStartChar =
+                (cp >= 0xC0 && cp <= 0xD6) || (cp >= 0xD8 && cp <= 0xF6) ||
+                (cp >= 0xF8 && cp <= 0x2FF) || (cp >= 0x370 && cp <= 0x37D) ||
+                (cp >= 0x37F && cp <= 0x1FFF) || (cp >= 0x200C && cp <= 0x200D) ||
+                (cp >= 0x2070 && cp <= 0x218F) || (cp >= 0x2C00 && cp <= 0x2FEF) ||
+                (cp >= 0x3001 && cp <= 0xD7FF) || (cp >= 0xF900 && cp <= 0xFDCF) ||
+                (cp >= 0xFDF0 && cp <= 0xFFFD) || (cp >= 0x10000 && cp <= 0xEFFFF);
+            const bool isNameChar = isNameStartChar || cp == 0xB7 ||
+                (cp >= 0x300 && cp <= 0x36F) || (cp >= 0x203F && cp <= 0x2040);
+
+            if (!(isStart ? isNameStartChar : isNameChar))
+                return reportError(InvalidName, docPos, name);
+        }
+        return true;
+    }
+
+    const char* skipSpacesAndComments(const char* docPos)
+    {
+        static const std::regex spacesAndComments(
+            "^(?:\\s+|\\s*" + getReComment() + "\\s*)+");
+        if (std::regex_search(docPos, m_skipMatch, spacesAndComments,
+                std::regex_constants::match_continuous))
+        {
+            docPos = m_skipMatch.suffix().first;
+        }
+        return docPos;
+    }
+
+    // Pass the internal subset of the document type declaration at docPos
+    // (if any) to the doctype() callback, and skip the declaration.
+    // Return false if stopped by the callback, or by an error.
+    bool parseDoctype(const char*& docPos, bool utf8)
+    {
+        if (enabled(xmlsax::Doctype))
+        {
+            std::cmatch match;
+            if (std::regex_search(docPos, match, getGrammar(utf8).doctype,
+                    std::regex_constants::match_continuous))
+            {
+                if (!checkUtf8(match.suffix().first) || !m_visitor.doctype(match[1]))
+                    return false;
+                docPos = skipSpacesAndComments(match.suffix().first);
+            }
+        }
+        else if (!strncmp(docPos, "<!DOCTYPE", 9))
+        {
+            if (!reportError(DoctypeDisabled, docPos))
+                return false;
+            const char* const subset = strpbrk(docPos, "[>");
+            docPos = skipStatement(docPos, subset && *subset == '[' ? "]>" : ">");
+        }
+
+        return true;
     }
 
 private: // data
     Visitor& m_visitor;
+    // Position of the last reported error
+    const char* m_errorPos;
+    // Errors collected in lint mode, otherwise nullptr
+    Diagnostics* m_diagnostics;
+    // UTF-8 validation: whether it's on, and how far the input is valid
+    bool m_checkUtf8;
+    const char* m_validated;
+
+    NodeStack m_nodeStack;
 
-    std::vector<String> m_nodeStack;
+    // Memory reused between elements (and documents, if the parser object
+    // is reused), to not allocate it for each of them
+    std::vector<String> m_attributeNames;
+    std::cmatch m_match;
+    std::cmatch m_attrMatch;
+    std::cmatch m_skipMatch;
+    std::string m_errorInfo;
 };
+
+/// The parser with all the features
+typedef XmlSaxParser<> XmlSax;
 } // headeronly
 
 #ifdef HO_SAX_CATCH_EXCEPTIONS
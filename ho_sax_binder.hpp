@@ -0,0 +1,442 @@
+/*
+MIT License
+
+Copyright (c) 2016 Maciej Kalinski https://github.com/rumcays
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+    @file  ho_sax_binder.hpp
+
+    @description
+    This is a part of header-only (see: wiki Header-only) tiny utils library.
+
+    Declarative binding of XML content to members of a C++ structure.
+    Element paths (and attribute names) are bound to the structure's
+    members once; the binder then may be used to parse any number of
+    documents straight into the structure, without hand-written visitors.
+    Subtrees that are not bound are skipped by the binder with
+    a depth counter only.
+
+    Supported member types:
+    * integral types, bool, floating point types - converted without
+      memory allocations; a value which cannot be converted, or is out
+      of the member's range, is a parse error
+    * std::string - converted with XmlSax::toStringValue() for
+      attributes, XmlSax::toStringText()/toStringCdata() for content
+    Values are unescaped once, before they are converted.
+    * std::vector of the above - each occurrence appends an item
+    The content of an element is all its text and CDATA, even if split
+    by comments, PIs or child elements; it is converted once, on exit.
+    An element without content, e.g. <host/>, has the empty one: a string
+    is cleared, a vector gets an item, a number is a conversion error.
+
+    Bindings are made at run time, with member pointers: the paths
+    are strings, which cannot be template arguments in C++11, and parsing
+    stays with XmlSax, so exactly the same documents are accepted.
+    Conversions are selected at compile time by the member types; what
+    the binding costs is a look-up in the path tree per element, and
+    a virtual call per bound value.
+
+    Paths are absolute, segments are separated with '/', e.g.:
+        struct Config { int port; std::string host; std::vector<int> ids; };
+
+        XmlSaxBinder<Config> binder;
+        binder.attribute("/config/server", "port", &Config::port)
+              .text("/config/server/host", &Config::host)
+              .text("/config/ids/id", &Config::ids);
+        Config config;
+        if (!binder.parse(doc, config))
+            std::cerr << binder.error() << std::endl;
+*/
+
+#ifndef HO_SAX_BINDER_HPP_
+#define HO_SAX_BINDER_HPP_
+
+#include <memory>
+#include <type_traits>
+#include "ho_sax.hpp"
+
+namespace headeronly
+{
+template <typename T>
+class XmlSaxBinder
+{
+public: // constructors
+    XmlSaxBinder():
+        m_nodes(1),
+        m_errorPos(nullptr)
+    {}
+
+public: // function members
+    // Bind the value of attribute of element at path to member
+    template <typename M>
+    XmlSaxBinder& attribute(const char* path, const char* name, M T::*member)
+    {
+        assert(name && *name);
+        return bind(path, name, member);
+    }
+
+    // Bind the content (text or CDATA) of element at path to member
+    template <typename M>
+    XmlSaxBinder& text(const char* path, M T::*member)
+    {
+        return bind(path, "", member);
+    }
+
+    // Parse doc and assign bound values to object's members.
+    // Return false if parsing failed or a value could not be converted;
+    // see error() and errorPosition() then.
+    bool parse(const char* doc, T& object)
+    {
+        Parser parser(*this, object);
+        m_error.clear();
+        m_errorPos = nullptr;
+        if (XmlSax(parser).parse(doc))
+            return true;
+
+        m_error = parser.m_error;
+        m_errorPos = parser.m_errorPos;
+        return false;
+    }
+
+    // Description and document position of the last parse() error
+    const std::string& error() const
+    {
+        return m_error;
+    }
+    const char* errorPosition() const
+    {
+        return m_errorPos;
+    }
+
+private: // types
+    struct Setter
+    {
+        virtual ~Setter() {}
+        virtual bool assign(
+            T& object,
+            const XmlSax::String& s,
+            bool isAttribute) const = 0;
+    };
+
+    template <typename M>
+    struct MemberSetter : Setter
+    {
+        MemberSetter(M T::*member):
+            m_member(member)
+        {}
+
+        virtual bool assign(
+            T& object,
+            const XmlSax::String& s,
+            bool isAttribute) const
+        {
+            return convert(s, isAttribute, object.*m_member);
+        }
+
+        M T::*m_member;
+    };
+
+    struct Binding
+    {
+        std::string attribute; // empty for content
+        std::unique_ptr<Setter> setter;
+    };
+
+    // Node of the path tree; the node 0 is above the root element
+    struct Node
+    {
+        std::string name;
+        std::vector<size_t> children;
+        std::vector<Binding> bindings;
+    };
+
+    struct Parser : XmlSax::Visitor
+    {
+        // Open element bound to a path tree node
+        struct Open
+        {
+            size_t node;
+            // Whether the node has content bindings
+            bool bindsContent;
+            // Start of the element's content in m_content, and its
+            // document position (nullptr if there is no content yet)
+            size_t contentStart;
+            const char* contentPos;
+        };
+
+        Parser(const XmlSaxBinder& binder, T& object):
+            m_binder(binder),
+            m_object(object),
+            m_skipDepth(0),
+            m_errorPos(nullptr)
+        {
+            open(0);
+        }
+
+        virtual bool enter(const XmlSax::String& element, bool)
+        {
+            if (!m_skipDepth)
+            {
+                const size_t child = m_binder.find(m_stack.back().node, element);
+                if (child)
+                    open(child);
+                else
+                    ++m_skipDepth;
+            }
+            else
+            {
+                ++m_skipDepth;
+            }
+            return true;
+        }
+        virtual bool exit(const XmlSax::String& element, bool)
+        {
+            if (m_skipDepth)
+            {
+                --m_skipDepth;
+                return true;
+            }
+
+            // An element without content (e.g. <host/>) has the empty one
+            const Open open = m_stack.back();
+            bool assigned = true;
+            if (open.bindsContent)
+            {
+                assigned = assign(XmlSax::String(), XmlSax::String(
+                    m_content.data() + open.contentStart,
+                    m_content.data() + m_content.size()),
+                    false, open.contentPos ? open.contentPos : element.first);
+                m_content.resize(open.contentStart);
+            }
+            m_stack.pop_back();
+            return assigned;
+        }
+        virtual bool attribute(
+            const XmlSax::String& name,
+            const XmlSax::String& value)
+        {
+            if (m_skipDepth)
+                return true;
+            // Unescaped once here, as the content is
+            XmlSax::toStringValue(value, m_chunk);
+            return assign(name,
+                XmlSax::String(m_chunk.data(), m_chunk.data() + m_chunk.size()),
+                true, value.first);
+        }
+        virtual bool text(const XmlSax::String& content)
+        {
+            if (addContent(content))
+            {
+                // Unescaped here, as CDATA may follow
+                XmlSax::toStringValue(content, m_chunk);
+                m_content += m_chunk;
+            }
+            return true;
+        }
+        virtual bool cdata(const XmlSax::String& content)
+        {
+            if (addContent(content))
+                m_content.append(content.first, content.second);
+            return true;
+        }
+        virtual void error(const char* info, const char* docPos)
+        {
+            m_error = info;
+            m_errorPos = docPos;
+        }
+
+        void open(size_t node)
+        {
+            Open open;
+            open.node = node;
+            open.bindsContent = false;
+            for (const auto& binding : m_binder.m_nodes[node].bindings)
+                open.bindsContent = open.bindsContent || binding.attribute.empty();
+            open.contentStart = m_content.size();
+            open.contentPos = nullptr;
+            m_stack.push_back(open);
+        }
+
+        // Whether content of the current element is to be collected
+        bool addContent(const XmlSax::String& content)
+        {
+            if (m_skipDepth || !m_stack.back().bindsContent)
+                return false;
+            if (!m_stack.back().contentPos)
+                m_stack.back().contentPos = content.first;
+            return true;
+        }
+
+        // Assign value of an attribute, or the content of the current
+        // element, both already unescaped, to the bound members
+        bool assign(
+            const XmlSax::String& name,
+            const XmlSax::String& value,
+            bool isAttribute,
+            const char* docPos)
+        {
+            const Node& node = m_binder.m_nodes[m_stack.back().node];
+            for (const auto& binding : node.bindings)
+            {
+                if (binding.attribute.empty() == isAttribute ||
+                    (isAttribute && !equal(name, binding.attribute)))
+                    continue;
+
+                if (!binding.setter->assign(m_object, value, isAttribute))
+                {
+                    m_error = "ERROR: invalid value of " + (isAttribute ?
+                        "attribute \"" + binding.attribute + "\"" :
+                        "element \"" + node.name + "\"");
+                    m_errorPos = docPos;
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        const XmlSaxBinder& m_binder;
+        T& m_object;
+        // Open elements, which are not skipped
+        std::vector<Open> m_stack;
+        // Content of the open elements, each one after its parent's;
+        // and memory reused to unescape text
+        std::string m_content;
+        std::string m_chunk;
+        // Depth inside of an unbound subtree
+        size_t m_skipDepth;
+        std::string m_error;
+        const char* m_errorPos;
+    };
+
+private: // functions
+    template <typename M>
+    XmlSaxBinder& bind(const char* path, const char* attribute, M T::*member)
+    {
+        assert(path && *path == '/');
+
+        size_t node = 0;
+        for (const char* pos = path; *pos;)
+        {
+            assert(*pos == '/');
+            const char* const begin = ++pos;
+            while (*pos && *pos != '/')
+                ++pos;
+            assert(pos != begin && "empty path segment");
+
+            const XmlSax::String segment(begin, pos);
+            size_t child = find(node, segment);
+            if (!child)
+            {
+                child = m_nodes.size();
+                m_nodes.push_back(Node());
+                m_nodes.back().name.assign(begin, pos);
+                m_nodes[node].children.push_back(child);
+            }
+            node = child;
+        }
+
+        Binding binding;
+        binding.attribute = attribute;
+        binding.setter.reset(new MemberSetter<M>(member));
+        m_nodes[node].bindings.push_back(std::move(binding));
+
+        return *this;
+    }
+
+    // Child of node with given name; 0 if not found
+    size_t find(size_t node, const XmlSax::String& name) const
+    {
+        for (const size_t child : m_nodes[node].children)
+        {
+            if (equal(name, m_nodes[child].name))
+                return child;
+        }
+        return 0;
+    }
+
+    static bool equal(const XmlSax::String& s1, const std::string& s2)
+    {
+        return static_cast<size_t>(s1.second - s1.first) == s2.size() &&
+            !s2.compare(0, s2.size(), s1.first, s2.size());
+    }
+
+    template <typename M>
+    static typename std::enable_if<
+        std::is_integral<M>::value && !std::is_same<M, bool>::value,
+        bool>::type
+    convert(const XmlSax::String& s, bool, M& member)
+    {
+        return XmlSax::parseInt(s, member);
+    }
+
+    template <typename M>
+    static typename std::enable_if<
+        std::is_floating_point<M>::value, bool>::type
+    convert(const XmlSax::String& s, bool, M& member)
+    {
+        double value = 0;
+        if (!XmlSax::parseDouble(s, value))
+            return false;
+        member = static_cast<M>(value);
+        return true;
+    }
+
+    static bool convert(const XmlSax::String& s, bool, bool& member)
+    {
+        return XmlSax::parseUnescapedBool(s, member);
+    }
+
+    // Values are unescaped already; content is only normalized as CDATA
+    static bool convert(
+        const XmlSax::String& s,
+        bool isAttribute,
+        std::string& member)
+    {
+        if (isAttribute)
+            member.assign(s.first, s.second);
+        else
+            XmlSax::toStringCdata(s, member);
+        return true;
+    }
+
+    template <typename M>
+    static bool convert(
+        const XmlSax::String& s,
+        bool isAttribute,
+        std::vector<M>& member)
+    {
+        M value = M();
+        if (!convert(s, isAttribute, value))
+            return false;
+        member.push_back(std::move(value));
+        return true;
+    }
+
+private: // data
+    std::vector<Node> m_nodes;
+
+    std::string m_error;
+    const char* m_errorPos;
+};
+} // headeronly
+
+#endif // HO_SAX_BINDER_HPP_
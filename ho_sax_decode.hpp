@@ -0,0 +1,345 @@
+/*
+MIT License
+
+Copyright (c) 2016 Maciej Kalinski https://github.com/rumcays
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+    @file  ho_sax_decode.hpp
+
+    @description
+    This is a part of header-only (see: wiki Header-only) tiny utils library.
+
+    Decoders of binary payloads carried by XML text or CDATA:
+    hex pairs (e.g. "00 ff 1a bf") and base64.
+    The decoders operate directly on XmlSax::String content, skip
+    white spaces and line breaks (between hex pairs, not inside them),
+    and write bytes to a caller's buffer.
+    Input may be split into chunks at any position (e.g. text interleaved
+    with comments, or CDATA sections following each other); the decoder
+    object keeps the state between chunks. Base64 input may also be
+    a sequence of padded streams, e.g. CDATA sections encoded separately.
+
+    Usage:
+        unsigned char buffer[256];
+        size_t size = 0;
+        if (!XmlSaxHexDecoder::decodeAll(content, buffer, sizeof(buffer), size))
+            ...
+
+        XmlSaxBase64Decoder decoder; // in a visitor
+        decoder.decode(chunk1, buffer, sizeof(buffer), size);
+        decoder.decode(chunk2, buffer, sizeof(buffer), size);
+        if (!decoder.finish())
+            ...
+
+    Output size of n input characters is at most n/2 for hex, and
+    3*n/4 for base64.
+*/
+
+#ifndef HO_SAX_DECODE_HPP_
+#define HO_SAX_DECODE_HPP_
+
+#include "ho_sax.hpp"
+
+namespace headeronly
+{
+namespace xmlsaxdecode
+{
+enum
+{
+    Space = -1,
+    Invalid = -2,
+    Padding = -3
+};
+
+// Character lookup tables; digit values or one of the codes above
+inline const signed char* hexTable()
+{
+    static signed char table[256];
+    static const bool initialized = [&]() -> bool
+    {
+        for (int c = 0; c < 256; ++c)
+        {
+            table[c] = (c >= '0' && c <= '9') ? static_cast<signed char>(c - '0') :
+                (c >= 'a' && c <= 'f') ? static_cast<signed char>(c - 'a' + 10) :
+                (c >= 'A' && c <= 'F') ? static_cast<signed char>(c - 'A' + 10) :
+                isspace(c) ? static_cast<signed char>(Space) :
+                static_cast<signed char>(Invalid);
+        }
+        return true;
+    }();
+    (void)initialized;
+    return table;
+}
+
+inline const signed char* base64Table()
+{
+    static signed char table[256];
+    static const bool initialized = [&]() -> bool
+    {
+        static const char digits[] =
+            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (int c = 0; c < 256; ++c)
+        {
+            const char* const digit =
+                c ? strchr(digits, c) : nullptr;
+            table[c] = digit ? static_cast<signed char>(digit - digits) :
+                c == '=' ? static_cast<signed char>(Padding) :
+                isspace(c) ? static_cast<signed char>(Space) :
+                static_cast<signed char>(Invalid);
+        }
+        return true;
+    }();
+    (void)initialized;
+    return table;
+}
+} // xmlsaxdecode
+
+class XmlSaxHexDecoder
+{
+public: // constructors
+    XmlSaxHexDecoder():
+        m_pending(-1)
+    {}
+
+public: // function members
+    // Decode chunk appending bytes to out; size is the number of bytes
+    // already stored in out, and it's increased by the decoded ones.
+    // Return false on invalid character, or if capacity is exceeded.
+    bool decode(
+        const XmlSax::String& chunk,
+        unsigned char* out,
+        size_t capacity,
+        size_t& size)
+    {
+        assert(chunk.first <= chunk.second && size <= capacity);
+
+        const signed char* const table = xmlsaxdecode::hexTable();
+        const unsigned char* pos =
+            reinterpret_cast<const unsigned char*>(chunk.first);
+        const unsigned char* const end =
+            reinterpret_cast<const unsigned char*>(chunk.second);
+
+        while (pos != end)
+        {
+            // Fast path: a pair of digits
+            if (m_pending < 0 && end - pos >= 2)
+            {
+                const int high = table[pos[0]];
+                const int low = table[pos[1]];
+                if ((high | low) >= 0)
+                {
+                    if (size == capacity)
+                        return false;
+                    out[size++] = static_cast<unsigned char>(high << 4 | low);
+                    pos += 2;
+                    continue;
+                }
+            }
+
+            const int digit = table[*pos++];
+            if (digit == xmlsaxdecode::Space && m_pending < 0)
+                continue;
+            if (digit < 0)
+                return false;
+
+            if (m_pending < 0)
+            {
+                m_pending = digit;
+            }
+            else
+            {
+                if (size == capacity)
+                    return false;
+                out[size++] = static_cast<unsigned char>(m_pending << 4 | digit);
+                m_pending = -1;
+            }
+        }
+
+        return true;
+    }
+
+    // Return false if the input ended in the middle of a byte
+    bool finish() const
+    {
+        return m_pending < 0;
+    }
+
+    void reset()
+    {
+        m_pending = -1;
+    }
+
+    // Decode the whole content to out; size is set to the number
+    // of decoded bytes.
+    static bool decodeAll(
+        const XmlSax::String& it,
+        unsigned char* out,
+        size_t capacity,
+        size_t& size)
+    {
+        XmlSaxHexDecoder decoder;
+        size = 0;
+        return decoder.decode(it, out, capacity, size) && decoder.finish();
+    }
+
+private: // data
+    // Value of the high half of byte, if already decoded
+    int m_pending;
+};
+
+class XmlSaxBase64Decoder
+{
+public: // constructors
+    XmlSaxBase64Decoder():
+        m_bits(0),
+        m_count(0),
+        m_padding(0)
+    {}
+
+public: // function members
+    // See XmlSaxHexDecoder::decode()
+    bool decode(
+        const XmlSax::String& chunk,
+        unsigned char* out,
+        size_t capacity,
+        size_t& size)
+    {
+        assert(chunk.first <= chunk.second && size <= capacity);
+
+        const signed char* const table = xmlsaxdecode::base64Table();
+        const unsigned char* pos =
+            reinterpret_cast<const unsigned char*>(chunk.first);
+        const unsigned char* const end =
+            reinterpret_cast<const unsigned char*>(chunk.second);
+
+        while (pos != end)
+        {
+            // Fast path: a quadruple of digits
+            if (!m_count && !m_padding && end - pos >= 4)
+            {
+                const int d0 = table[pos[0]];
+                const int d1 = table[pos[1]];
+                const int d2 = table[pos[2]];
+                const int d3 = table[pos[3]];
+                if ((d0 | d1 | d2 | d3) >= 0)
+                {
+                    if (capacity - size < 3)
+                        return false;
+                    const unsigned long bits =
+                        static_cast<unsigned long>(d0) << 18 |
+                        static_cast<unsigned long>(d1) << 12 |
+                        static_cast<unsigned long>(d2) << 6 |
+                        static_cast<unsigned long>(d3);
+                    out[size++] = static_cast<unsigned char>(bits >> 16);
+                    out[size++] = static_cast<unsigned char>(bits >> 8);
+                    out[size++] = static_cast<unsigned char>(bits);
+                    pos += 4;
+                    continue;
+                }
+            }
+
+            const int digit = table[*pos++];
+            if (digit == xmlsaxdecode::Space)
+                continue;
+
+            if (digit == xmlsaxdecode::Padding)
+            {
+                // "xx==" or "xxx="; the next stream may follow them
+                if (m_padding)
+                {
+                    reset();
+                    continue;
+                }
+                if (m_count < 2)
+                    return false;
+
+                const size_t bytes = m_count - 1;
+                if (capacity - size < bytes)
+                    return false;
+                m_bits <<= 6 * (4 - m_count);
+                out[size++] = static_cast<unsigned char>(m_bits >> 16);
+                if (bytes == 2)
+                {
+                    out[size++] = static_cast<unsigned char>(m_bits >> 8);
+                    reset();
+                }
+                else
+                {
+                    m_padding = 1;
+                }
+                continue;
+            }
+
+            if (digit < 0 || m_padding)
+                return false;
+
+            m_bits = m_bits << 6 | static_cast<unsigned long>(digit);
+            if (++m_count == 4)
+            {
+                if (capacity - size < 3)
+                    return false;
+                out[size++] = static_cast<unsigned char>(m_bits >> 16);
+                out[size++] = static_cast<unsigned char>(m_bits >> 8);
+                out[size++] = static_cast<unsigned char>(m_bits);
+                m_bits = 0;
+                m_count = 0;
+            }
+        }
+
+        return true;
+    }
+
+    // Return false if the input ended in the middle of a quadruple
+    bool finish() const
+    {
+        return !m_count;
+    }
+
+    void reset()
+    {
+        m_bits = 0;
+        m_count = 0;
+        m_padding = 0;
+    }
+
+    // See XmlSaxHexDecoder::decodeAll()
+    static bool decodeAll(
+        const XmlSax::String& it,
+        unsigned char* out,
+        size_t capacity,
+        size_t& size)
+    {
+        XmlSaxBase64Decoder decoder;
+        size = 0;
+        return decoder.decode(it, out, capacity, size) && decoder.finish();
+    }
+
+private: // data
+    unsigned long m_bits;
+    // Number of digits in m_bits
+    size_t m_count;
+    // Whether "xx=" has been seen, so the second '=' is expected
+    int m_padding;
+};
+} // headeronly
+
+#endif // HO_SAX_DECODE_HPP_
@@ -0,0 +1,589 @@
+/*
+MIT License
+
+Copyright (c) 2016 Maciej Kalinski https://github.com/rumcays
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+    @file  ho_sax_diff.hpp
+
+    @description
+    This is a part of header-only (see: wiki Header-only) tiny utils library.
+
+    Differences between consecutive versions of a document, e.g. for
+    reloading configuration files.
+    Every parsed version is digested into a list of elements with hashes
+    of their content and of their whole subtrees. The next version is
+    compared against it: subtrees with equal hashes are skipped, for
+    remaining ones the diff visitor is notified about added, removed and
+    changed elements, and about changed attributes.
+
+    Elements are identified by their paths, with the index among
+    the siblings of the same name, e.g. "/Root[1]/Item[2]"; they are keyed
+    by hashes of the paths (the names and indexes are compared on a key
+    match), and the path strings are built only for the reported elements.
+    Text and attribute values are compared after normalization performed
+    by XmlSax::toStringText() and XmlSax::toStringValue(), so changes of
+    insignificant white spaces are not reported. Text and CDATA content
+    of an element are compared together, with their positions among
+    the children.
+    Content is compared by 64-bit hashes only: a subtree, text or value
+    of a colliding hash would be reported as unchanged (the chance of
+    that is negligible, unless the documents are crafted against it).
+
+    The document is always parsed as a whole; what is saved is the work
+    (and callbacks) related to unchanged subtrees. Memory of the digests
+    is reused, so reloads of a document of similar size don't allocate it.
+*/
+
+#ifndef HO_SAX_DIFF_HPP_
+#define HO_SAX_DIFF_HPP_
+
+#include <algorithm>
+#include <unordered_map>
+#include "ho_sax.hpp"
+
+namespace headeronly
+{
+class XmlSaxDiff
+{
+public: // types
+    /// Callback base
+    /// If an overridden callback function returns false, reporting stops
+    /// and XmlSaxDiff::parse() returns false.
+    struct Visitor
+    {
+        virtual ~Visitor() {}
+
+        /// The element (and its whole subtree) appeared/disappeared
+        virtual bool added(const std::string& /*path*/)
+        { return true; }
+        virtual bool removed(const std::string& /*path*/)
+        { return true; }
+        /// Text or CDATA content of the element changed
+        virtual bool changed(const std::string& /*path*/)
+        { return true; }
+        /// Attribute of the element was added or its value changed;
+        /// value is null if the attribute was removed
+        virtual bool attribute(
+            const std::string& /*path*/,
+            const std::string& /*name*/,
+            const XmlSax::String* /*value*/)
+        { return true; }
+
+        /// Handle parsing error, see XmlSax::Visitor::error()
+        virtual void error(const char* /*info*/, const char* /*docPos*/)
+        {}
+    };
+
+public: // constructors
+    XmlSaxDiff(Visitor& visitor):
+        m_visitor(visitor),
+        m_collector(visitor, m_current)
+    {}
+
+public: // function members
+    // Parse doc and report its differences against the previously parsed
+    // document; for the first one, root element is reported as added.
+    // Return false if parsing process failed (the previous document is
+    // kept as the reference then), or a callback function returned false.
+    bool parse(const char* doc)
+    {
+        m_collector.reset();
+        if (!XmlSax(m_collector).parse(doc))
+            return false;
+        m_current.index();
+
+        const bool retCode = report();
+
+        // Values of attributes are not valid after the call
+        for (auto& attribute : m_current.attributes)
+            attribute.value = XmlSax::String();
+        std::swap(m_previous, m_current);
+
+        return retCode;
+    }
+
+    // Forget the previously parsed document
+    void clear()
+    {
+        m_previous.clear();
+    }
+
+private: // types
+    // Names are stored as [offset, offset + length) of Document::names
+    struct Attribute
+    {
+        size_t name;
+        size_t nameLength;
+        uint64_t hash;
+        XmlSax::String value;
+    };
+
+    struct Node
+    {
+        // Hash of the path, see Collector::enter()
+        uint64_t key;
+        // Index of the parent node, or npos for the root
+        size_t parent;
+        // Index among siblings of the same name, from 1
+        size_t index;
+        size_t name;
+        size_t nameLength;
+        // Index past the last node of the subtree
+        size_t end;
+        // [attributes, attributesEnd) of Document::attributes
+        size_t attributes;
+        size_t attributesEnd;
+        uint64_t textHash;
+        uint64_t subtreeHash;
+    };
+
+    // Digest of a document; its memory is reused for the next ones,
+    // so there are no allocations once it is big enough
+    struct Document
+    {
+        void clear()
+        {
+            nodes.clear();
+            attributes.clear();
+            names.clear();
+            keys.clear();
+        }
+
+        // Sort the keys for find()
+        void index()
+        {
+            keys.clear();
+            for (size_t n = 0; n < nodes.size(); ++n)
+                keys.push_back(std::make_pair(nodes[n].key, n));
+            std::sort(keys.begin(), keys.end());
+        }
+
+        // First of the (key, node index) pairs with the key, if any
+        std::vector<std::pair<uint64_t, size_t> >::const_iterator
+        lowerBound(uint64_t key) const
+        {
+            return std::lower_bound(keys.begin(), keys.end(),
+                std::make_pair(key, size_t(0)));
+        }
+
+        bool equalNames(
+            size_t name,
+            size_t length,
+            const Document& other,
+            size_t otherName,
+            size_t otherLength) const
+        {
+            return length == otherLength &&
+                !names.compare(name, length, other.names, otherName, otherLength);
+        }
+
+        std::vector<Node> nodes;
+        std::vector<Attribute> attributes;
+        std::string names;
+        // (key, node index) pairs, sorted
+        std::vector<std::pair<uint64_t, size_t> > keys;
+    };
+
+    // Builds the document's digest; nodes are stored in document order
+    struct Collector : XmlSax::Visitor
+    {
+        Collector(XmlSaxDiff::Visitor& visitor, Document& document):
+            m_visitor(visitor),
+            m_document(document),
+            m_depth(0)
+        {}
+
+        // Prepare for the next document
+        void reset()
+        {
+            m_document.clear();
+            m_depth = 0;
+            m_text.clear();
+        }
+
+        virtual bool enter(const XmlSax::String& element, bool)
+        {
+            flushText();
+
+            // Index among siblings of the same name
+            size_t index = 1;
+            uint64_t key = XmlSax::hash(XmlSax::String());
+            size_t parent = std::string::npos;
+            if (m_depth)
+            {
+                Open& open = m_stack[m_depth - 1];
+                const uint64_t nameHash = XmlSax::hash(element);
+                const auto range = open.names.equal_range(nameHash);
+                auto it = range.first;
+                while (it != range.second && !equalName(it->second, element))
+                    ++it;
+                if (it == range.second)
+                {
+                    open.names.insert(std::make_pair(nameHash, m_document.nodes.size()));
+                }
+                else
+                {
+                    index = m_document.nodes[it->second].index + 1;
+                    it->second = m_document.nodes.size();
+                }
+                ++open.children;
+
+                parent = open.node;
+                key = m_document.nodes[parent].key;
+            }
+
+            // The path: the parent's one, the depth, the name and the index
+            key = record('N', element,
+                hash(index, hash(static_cast<uint64_t>(m_depth), key)));
+
+            Node node;
+            node.key = key;
+            node.parent = parent;
+            node.index = index;
+            node.name = m_document.names.size();
+            node.nameLength = static_cast<size_t>(element.second - element.first);
+            node.end = 0;
+            node.attributes = m_document.attributes.size();
+            node.attributesEnd = node.attributes;
+            node.textHash = XmlSax::hash(XmlSax::String());
+            node.subtreeHash = record('E', element, XmlSax::hash(XmlSax::String()));
+            m_document.names.append(element.first, element.second);
+
+            // Open entries are reused, to not allocate their maps again
+            if (m_depth == m_stack.size())
+                m_stack.push_back(Open());
+            Open& open = m_stack[m_depth++];
+            open.node = m_document.nodes.size();
+            open.children = 0;
+            if (!open.names.empty())
+                open.names.clear();
+            m_document.nodes.push_back(node);
+
+            return true;
+        }
+        virtual bool exit(const XmlSax::String&, bool)
+        {
+            assert(m_depth);
+
+            flushText();
+            Node& node = m_document.nodes[m_stack[--m_depth].node];
+            node.end = m_document.nodes.size();
+
+            if (m_depth)
+            {
+                Node& parent = current();
+                parent.subtreeHash = hash(node.subtreeHash,
+                    record('C', XmlSax::String(), parent.subtreeHash));
+            }
+
+            return true;
+        }
+        virtual bool attribute(
+            const XmlSax::String& name,
+            const XmlSax::String& value)
+        {
+            Node& node = current();
+            XmlSax::toStringValue(value, m_buffer);
+
+            Attribute attribute;
+            attribute.name = m_document.names.size();
+            attribute.nameLength = static_cast<size_t>(name.second - name.first);
+            attribute.hash = hashString(m_buffer);
+            attribute.value = value;
+            m_document.names.append(name.first, name.second);
+
+            node.subtreeHash = record('A', name, node.subtreeHash);
+            node.subtreeHash = hash(attribute.hash,
+                record('V', XmlSax::String(), node.subtreeHash));
+            m_document.attributes.push_back(attribute);
+            node.attributesEnd = m_document.attributes.size();
+
+            return true;
+        }
+        virtual bool text(const XmlSax::String& content)
+        {
+            m_text.push_back(content);
+            return true;
+        }
+        virtual bool cdata(const XmlSax::String& content)
+        {
+            flushText();
+            XmlSax::toStringCdata(content, m_buffer);
+            append(m_buffer);
+            return true;
+        }
+        virtual void error(const char* info, const char* docPos)
+        {
+            m_visitor.error(info, docPos);
+        }
+
+        Node& current()
+        {
+            assert(m_depth);
+            return m_document.nodes[m_stack[m_depth - 1].node];
+        }
+
+        // Whether node n has the name
+        bool equalName(size_t n, const XmlSax::String& name) const
+        {
+            const Node& node = m_document.nodes[n];
+            return node.nameLength == static_cast<size_t>(name.second - name.first) &&
+                !m_document.names.compare(node.name, node.nameLength,
+                    name.first, node.nameLength);
+        }
+
+        // Text chunks split by comments or PIs are buffered until the run
+        // of them is complete, and compared as one
+        void flushText()
+        {
+            if (m_text.empty())
+                return;
+
+            m_run.clear();
+            for (const auto& chunk : m_text)
+                m_run.append(chunk.first, chunk.second);
+            m_text.clear();
+
+            XmlSax::toStringText(
+                XmlSax::String(m_run.data(), m_run.data() + m_run.size()),
+                m_buffer);
+            append(m_buffer);
+        }
+
+        // Hash the content with the number of the children preceding it,
+        // so e.g. <a>x<b/>y</a> and <a>xy<b/></a> don't hash the same;
+        // white spaces between the children are insignificant
+        void append(const std::string& content)
+        {
+            if (content.empty())
+                return;
+
+            Node& node = current();
+            const uint64_t position = m_stack[m_depth - 1].children;
+            const XmlSax::String s(content.data(), content.data() + content.size());
+            node.textHash = record('T', s, hash(position, node.textHash));
+            node.subtreeHash = record('T', s, hash(position, node.subtreeHash));
+        }
+
+        struct Open
+        {
+            size_t node;
+            size_t children;
+            // The last child with given name, by the hash of the name
+            std::unordered_multimap<uint64_t, size_t> names;
+        };
+
+        XmlSaxDiff::Visitor& m_visitor;
+        Document& m_document;
+        // Open elements are [0, m_depth) of m_stack
+        std::vector<Open> m_stack;
+        size_t m_depth;
+        std::vector<XmlSax::String> m_text;
+        std::string m_run;
+        std::string m_buffer;
+    };
+
+    enum State
+    {
+        Unmatched,
+        Matched,
+        Same
+    };
+
+private: // functions
+    static uint64_t hash(uint64_t value, uint64_t seed)
+    {
+        const char* const s = reinterpret_cast<const char*>(&value);
+        return XmlSax::hash(XmlSax::String(s, s + sizeof(value)), seed);
+    }
+
+    // Record of the subtree hash: its tag and length precede the content,
+    // so e.g. names "a" + "bc" and "ab" + "c" don't hash the same
+    static uint64_t record(char tag, const XmlSax::String& s, uint64_t seed)
+    {
+        seed = XmlSax::hash(XmlSax::String(&tag, &tag + 1), seed);
+        seed = hash(static_cast<uint64_t>(s.second - s.first), seed);
+        return XmlSax::hash(s, seed);
+    }
+
+    static uint64_t hashString(
+        const std::string& s,
+        uint64_t seed = XmlSax::hash(XmlSax::String()))
+    {
+        return XmlSax::hash(
+            XmlSax::String(s.data(), s.data() + s.size()), seed);
+    }
+
+    // Path of the node, e.g. "/Root[1]/Item[2]"; built for reporting only
+    const std::string& path(const Document& document, size_t n)
+    {
+        m_ancestors.clear();
+        for (; n != std::string::npos; n = document.nodes[n].parent)
+            m_ancestors.push_back(n);
+
+        m_path.clear();
+        for (auto it = m_ancestors.rbegin(); it != m_ancestors.rend(); ++it)
+        {
+            const Node& node = document.nodes[*it];
+            m_path += '/';
+            m_path.append(document.names, node.name, node.nameLength);
+            m_path += '[';
+            m_path += std::to_string(node.index);
+            m_path += ']';
+        }
+        return m_path;
+    }
+
+    // Index of the previous document's node at the path of node n,
+    // or npos; keys are hashes, so the paths are compared on a match:
+    // the parents are matched already, as the nodes are in document order
+    size_t findPrevious(size_t n) const
+    {
+        const Node& node = m_current.nodes[n];
+        const size_t parent = node.parent == std::string::npos ?
+            std::string::npos : m_matches[node.parent];
+        for (auto it = m_previous.lowerBound(node.key);
+            it != m_previous.keys.end() && it->first == node.key; ++it)
+        {
+            const Node& old = m_previous.nodes[it->second];
+            if (old.parent == parent && old.index == node.index &&
+                m_current.equalNames(node.name, node.nameLength,
+                    m_previous, old.name, old.nameLength))
+                return it->second;
+        }
+        return std::string::npos;
+    }
+
+    bool report()
+    {
+        const std::vector<Node>& nodes = m_current.nodes;
+        const std::vector<Node>& previous = m_previous.nodes;
+        m_states.assign(previous.size(), Unmatched);
+        m_matches.assign(nodes.size(), std::string::npos);
+
+        for (size_t n = 0; n < nodes.size();)
+        {
+            const Node& node = nodes[n];
+            const size_t match = findPrevious(n);
+            if (match == std::string::npos)
+            {
+                if (!m_visitor.added(path(m_current, n)))
+                    return false;
+                n = node.end;
+                continue;
+            }
+
+            const Node& old = previous[match];
+            if (old.subtreeHash == node.subtreeHash)
+            {
+                m_states[match] = Same;
+                n = node.end;
+                continue;
+            }
+
+            m_states[match] = Matched;
+            m_matches[n] = match;
+            if (!reportAttributes(old, node, n) ||
+                (old.textHash != node.textHash &&
+                    !m_visitor.changed(path(m_current, n))))
+                return false;
+            ++n;
+        }
+
+        for (size_t n = 0; n < previous.size();)
+        {
+            switch (m_states[n])
+            {
+            case Unmatched:
+                if (!m_visitor.removed(path(m_previous, n)))
+                    return false;
+                n = previous[n].end;
+                break;
+            case Same:
+                n = previous[n].end;
+                break;
+            default:
+                ++n;
+            }
+        }
+
+        return true;
+    }
+
+    // n is the index of node
+    bool reportAttributes(const Node& old, const Node& node, size_t n)
+    {
+        const auto begin = m_current.attributes.begin();
+        const auto oldBegin = m_previous.attributes.begin();
+
+        for (auto attribute = begin + node.attributes;
+            attribute != begin + node.attributesEnd; ++attribute)
+        {
+            auto it = oldBegin + old.attributes;
+            while (it != oldBegin + old.attributesEnd &&
+                !m_current.equalNames(attribute->name, attribute->nameLength,
+                    m_previous, it->name, it->nameLength))
+                ++it;
+            if ((it == oldBegin + old.attributesEnd || it->hash != attribute->hash) &&
+                !m_visitor.attribute(path(m_current, n),
+                    m_current.names.substr(attribute->name, attribute->nameLength),
+                    &attribute->value))
+                return false;
+        }
+
+        for (auto attribute = oldBegin + old.attributes;
+            attribute != oldBegin + old.attributesEnd; ++attribute)
+        {
+            auto it = begin + node.attributes;
+            while (it != begin + node.attributesEnd &&
+                !m_current.equalNames(it->name, it->nameLength,
+                    m_previous, attribute->name, attribute->nameLength))
+                ++it;
+            if (it == begin + node.attributesEnd &&
+                !m_visitor.attribute(path(m_current, n),
+                    m_previous.names.substr(attribute->name, attribute->nameLength),
+                    nullptr))
+                return false;
+        }
+
+        return true;
+    }
+
+private: // data
+    Visitor& m_visitor;
+
+    // The previously parsed document, and the one being compared with it
+    Document m_previous;
+    Document m_current;
+    Collector m_collector;
+
+    // Memory reused for reporting
+    std::vector<State> m_states;
+    // Indexes of the previous document's nodes matched by the current ones
+    std::vector<size_t> m_matches;
+    std::vector<size_t> m_ancestors;
+    std::string m_path;
+};
+} // headeronly
+
+#endif // HO_SAX_DIFF_HPP_
@@ -0,0 +1,547 @@
+/*
+MIT License
+
+Copyright (c) 2016 Maciej Kalinski https://github.com/rumcays
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+/*
+    @file  ho_sax_hasher.hpp
+
+    @description
+    This is a part of header-only (see: wiki Header-only) tiny utils library.
+
+    Canonical content hash of a document, computed as XmlSax events arrive,
+    e.g. to detect real changes of configuration files.
+    What is hashed:
+    * element names
+    * attributes sorted by name, values normalized as by
+      XmlSax::toStringValue()
+    * text normalized as by XmlSax::toStringText(), CDATA as by
+      XmlSax::toStringCdata(); white space only content is skipped;
+      adjacent text chunks (e.g. split by a comment) are hashed as one
+    Comments, PIs, the XML declaration, attribute order and insignificant
+    white spaces do not change the hash.
+
+    Each element has its own hash of its name, attributes, text and its
+    children's hashes (a Merkle tree), so the hash of every subtree is
+    available too: override subtree(), called on each element's exit().
+    After warming up (the deepest nesting, the most attributes) hashing
+    does not allocate memory.
+
+    Algorithms: FNV-1a 64 and 128 bits (fast, non-cryptographic),
+    SHA-256 (slower, for untrusted input).
+
+    Usage:
+        XmlSaxHasher hasher;
+        XmlSax(hasher).parse(doc);
+        if (hasher.digest() != previous)
+            ...
+*/
+
+#ifndef HO_SAX_HASHER_HPP_
+#define HO_SAX_HASHER_HPP_
+
+#include "ho_sax.hpp"
+
+namespace headeronly
+{
+namespace xmlsaxhash
+{
+/// Hash value
+struct Digest
+{
+    Digest():
+        size(0)
+    {
+        memset(data, 0, sizeof(data));
+    }
+
+    bool operator==(const Digest& other) const
+    {
+        return size == other.size && !memcmp(data, other.data, size);
+    }
+    bool operator!=(const Digest& other) const
+    {
+        return !(*this == other);
+    }
+
+    // First (up to) 8 bytes as a number, e.g. for hash tables
+    uint64_t value() const
+    {
+        uint64_t v = 0;
+        for (size_t n = 0; n < size && n < sizeof(v); ++n)
+            v = (v << 8) | data[n];
+        return v;
+    }
+
+    std::string hex() const
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::string s;
+        for (size_t n = 0; n < size; ++n)
+        {
+            s += digits[data[n] >> 4];
+            s += digits[data[n] & 0xf];
+        }
+        return s;
+    }
+
+    uint8_t data[32];
+    size_t size;
+};
+
+enum Algorithm
+{
+    Fnv64,
+    Fnv128,
+    Sha256
+};
+
+/// Incremental hash of the chosen algorithm
+class Context
+{
+public:
+    explicit Context(Algorithm algorithm = Fnv64)
+    {
+        reset(algorithm);
+    }
+
+    void reset(Algorithm algorithm)
+    {
+        m_algorithm = algorithm;
+        m_size = 0;
+        switch (m_algorithm)
+        {
+        case Fnv64:
+            // The offset basis
+            m_state[0] = XmlSax::hash(XmlSax::String());
+            break;
+        case Fnv128:
+            m_state[0] = 0x6c62272e07bb0142ULL;
+            m_state[1] = 0x62b821756295c58dULL;
+            break;
+        case Sha256:
+            {
+                static const uint32_t init[8] = {
+                    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+                memcpy(m_sha, init, sizeof(m_sha));
+            }
+            break;
+        }
+    }
+
+    void update(const char* data, size_t size)
+    {
+        const uint8_t* pos = reinterpret_cast<const uint8_t*>(data);
+        const uint8_t* const end = pos + size;
+        switch (m_algorithm)
+        {
+        case Fnv64:
+            m_state[0] = XmlSax::hash(XmlSax::String(data, data + size), m_state[0]);
+            break;
+        case Fnv128:
+            for (; pos != end; ++pos)
+            {
+                m_state[1] ^= *pos;
+                multiplyFnv128();
+            }
+            break;
+        case Sha256:
+            for (; pos != end; ++pos)
+            {
+                m_block[m_size++ % 64] = *pos;
+                if (!(m_size % 64))
+                    transform();
+            }
+            break;
+        }
+    }
+
+    void update(char c)
+    {
+        update(&c, 1);
+    }
+
+    Digest finish()
+    {
+        Digest digest;
+        switch (m_algorithm)
+        {
+        case Fnv64:
+            digest.size = 8;
+            putBigEndian(m_state[0], digest.data);
+            break;
+        case Fnv128:
+            digest.size = 16;
+            putBigEndian(m_state[0], digest.data);
+            putBigEndian(m_state[1], digest.data + 8);
+            break;
+        case Sha256:
+            {
+                uint8_t length[8];
+                putBigEndian(m_size * 8, length);
+                update("\x80", 1);
+                while (m_size % 64 != 56)
+                    update("", 1);
+                update(reinterpret_cast<const char*>(length), sizeof(length));
+
+                digest.size = 32;
+                for (size_t n = 0; n < 8; ++n)
+                {
+                    for (size_t b = 0; b < 4; ++b)
+                        digest.data[4 * n + b] =
+                            static_cast<uint8_t>(m_sha[n] >> (24 - 8 * b));
+                }
+            }
+            break;
+        }
+        return digest;
+    }
+
+private:
+    static void putBigEndian(uint64_t value, uint8_t* data)
+    {
+        for (size_t n = 0; n < 8; ++n)
+            data[n] = static_cast<uint8_t>(value >> (56 - 8 * n));
+    }
+
+    // state *= 2^88 + 0x13b (mod 2^128); state[0] is the high half
+    void multiplyFnv128()
+    {
+        const uint64_t low = m_state[1];
+        const uint64_t lowLow = (low & 0xffffffffULL) * 0x13b;
+        const uint64_t lowHigh = (low >> 32) * 0x13b;
+        const uint64_t product = lowLow + (lowHigh << 32);
+        const uint64_t carry = (lowHigh >> 32) + (product < lowLow ? 1 : 0);
+
+        m_state[0] = m_state[0] * 0x13b + carry + (low << 24);
+        m_state[1] = product;
+    }
+
+    void transform()
+    {
+        static const uint32_t k[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b,
+            0x59f111f1, 0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01,
+            0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7,
+            0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+            0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152,
+            0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+            0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+            0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819,
+            0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116, 0x1e376c08,
+            0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f,
+            0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+            0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2 };
+
+        uint32_t w[64];
+        for (size_t n = 0; n < 16; ++n)
+        {
+            w[n] = static_cast<uint32_t>(m_block[4 * n]) << 24 |
+                static_cast<uint32_t>(m_block[4 * n + 1]) << 16 |
+                static_cast<uint32_t>(m_block[4 * n + 2]) << 8 |
+                m_block[4 * n + 3];
+        }
+        for (size_t n = 16; n < 64; ++n)
+        {
+            const uint32_t s0 = rotate(w[n - 15], 7) ^ rotate(w[n - 15], 18) ^
+                (w[n - 15] >> 3);
+            const uint32_t s1 = rotate(w[n - 2], 17) ^ rotate(w[n - 2], 19) ^
+                (w[n - 2] >> 10);
+            w[n] = w[n - 16] + s0 + w[n - 7] + s1;
+        }
+
+        uint32_t v[8];
+        memcpy(v, m_sha, sizeof(v));
+        for (size_t n = 0; n < 64; ++n)
+        {
+            const uint32_t s1 = rotate(v[4], 6) ^ rotate(v[4], 11) ^
+                rotate(v[4], 25);
+            const uint32_t ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+            const uint32_t t1 = v[7] + s1 + ch + k[n] + w[n];
+            const uint32_t s0 = rotate(v[0], 2) ^ rotate(v[0], 13) ^
+                rotate(v[0], 22);
+            const uint32_t maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+            const uint32_t t2 = s0 + maj;
+
+            memmove(v + 1, v, 7 * sizeof(*v));
+            v[4] += t1;
+            v[0] = t1 + t2;
+        }
+        for (size_t n = 0; n < 8; ++n)
+            m_sha[n] += v[n];
+    }
+
+    static uint32_t rotate(uint32_t x, unsigned n)
+    {
+        return (x >> n) | (x << (32 - n));
+    }
+
+    Algorithm m_algorithm;
+    // FNV state; high half first for 128 bits
+    uint64_t m_state[2];
+    // SHA-256 state, pending block, and the number of bytes hashed
+    uint32_t m_sha[8];
+    uint8_t m_block[64];
+    uint64_t m_size;
+};
+} // xmlsaxhash
+
+class XmlSaxHasher : public XmlSax::Visitor
+{
+public: // types
+    typedef xmlsaxhash::Digest Digest;
+    typedef xmlsaxhash::Algorithm Algorithm;
+
+public: // constructors
+    explicit XmlSaxHasher(Algorithm algorithm = xmlsaxhash::Fnv64):
+        m_algorithm(algorithm),
+        m_depth(0)
+    {
+        reset();
+    }
+
+public: // function members
+    // Start hashing a new document
+    void reset()
+    {
+        m_depth = 0;
+        m_attributes.clear();
+        m_text.clear();
+        if (m_contexts.empty())
+            m_contexts.push_back(xmlsaxhash::Context(m_algorithm));
+        m_contexts[0].reset(m_algorithm);
+    }
+
+    // Hash of the document (of all root elements, for parseFragments())
+    // hashed since the last reset()
+    Digest digest() const
+    {
+        assert(!m_depth && "digest() called while parsing");
+        xmlsaxhash::Context context = m_contexts[0];
+        return context.finish();
+    }
+
+    // Auxiliary: reset, parse doc, and return its digest;
+    // Return false if parsing failed.
+    bool parse(const char* doc, Digest& digest)
+    {
+        reset();
+        if (!XmlSax(*this).parse(doc))
+            return false;
+        digest = this->digest();
+        return true;
+    }
+
+    // Called with the hash of each element's subtree; depth of the root
+    // element is 1. Return false to stop parsing.
+    virtual bool subtree(const XmlSax::String&, size_t, const Digest&)
+    {
+        return true;
+    }
+
+    virtual bool enter(const XmlSax::String& element, bool)
+    {
+        flushAttributes();
+        flushText();
+
+        if (++m_depth == m_contexts.size())
+            m_contexts.push_back(xmlsaxhash::Context(m_algorithm));
+        xmlsaxhash::Context& context = m_contexts[m_depth];
+        context.reset(m_algorithm);
+        context.update('E');
+        context.update(element.first, size(element));
+        context.update('\0');
+        return true;
+    }
+    virtual bool exit(const XmlSax::String& element, bool)
+    {
+        assert(m_depth > 0);
+
+        flushAttributes();
+        flushText();
+        const Digest digest = m_contexts[m_depth].finish();
+        --m_depth;
+
+        xmlsaxhash::Context& parent = m_contexts[m_depth];
+        parent.update('S');
+        parent.update(reinterpret_cast<const char*>(digest.data), digest.size);
+
+        return subtree(element, m_depth + 1, digest);
+    }
+    virtual bool attribute(
+        const XmlSax::String& name,
+        const XmlSax::String& value)
+    {
+        m_attributes.push_back(std::make_pair(name, value));
+        return true;
+    }
+    virtual bool text(const XmlSax::String& content)
+    {
+        flushAttributes();
+        m_text.push_back(content);
+        return true;
+    }
+    virtual bool cdata(const XmlSax::String& content)
+    {
+        flushAttributes();
+        flushText();
+        hashContent('C', &content, &content + 1, false);
+        return true;
+    }
+
+private: // functions
+    static size_t size(const XmlSax::String& s)
+    {
+        assert(s.first <= s.second);
+        return static_cast<size_t>(s.second - s.first);
+    }
+
+    static bool isSpace(char c)
+    {
+        return isspace(static_cast<unsigned char>(c)) != 0;
+    }
+
+    // Attributes are buffered until the start tag is complete
+    void flushAttributes()
+    {
+        if (m_attributes.empty())
+            return;
+
+        // Stable for repeated names, the order of which is kept
+        std::stable_sort(m_attributes.begin(), m_attributes.end(),
+            [](const Attribute& a1, const Attribute& a2){
+                return std::lexicographical_compare(
+                    a1.first.first, a1.first.second,
+                    a2.first.first, a2.first.second);});
+
+        xmlsaxhash::Context& context = m_contexts[m_depth];
+        for (const auto& a : m_attributes)
+        {
+            context.update('A');
+            context.update(a.first.first, size(a.first));
+            context.update('\0');
+            updateNormalized(context, &a.second, &a.second + 1, false, true);
+            context.update('\0');
+        }
+        m_attributes.clear();
+    }
+
+    // Text chunks are buffered until the run of them is complete
+    void flushText()
+    {
+        if (m_text.empty())
+            return;
+        hashContent('T', m_text.data(), m_text.data() + m_text.size(), true);
+        m_text.clear();
+    }
+
+    // Hash the content chunks [begin, end) as one
+    void hashContent(
+        char tag,
+        const XmlSax::String* begin,
+        const XmlSax::String* end,
+        bool isText)
+    {
+        bool isSpaceOnly = true;
+        for (const XmlSax::String* s = begin; isSpaceOnly && s != end; ++s)
+        {
+            for (const char* pos = s->first; isSpaceOnly && pos != s->second; ++pos)
+                isSpaceOnly = isSpace(*pos);
+        }
+        if (isSpaceOnly)
+            return;
+
+        xmlsaxhash::Context& context = m_contexts[m_depth];
+        context.update(tag);
+        updateNormalized(context, begin, end, true, isText);
+        context.update('\0');
+    }
+
+    // Hash the concatenation of chunks [begin, end) normalized as by
+    // XmlSax::toString*(): white space sequences replaced by one space,
+    // and surrounding ones removed if trim; predefined entities replaced
+    // if unescape
+    static void updateNormalized(
+        xmlsaxhash::Context& context,
+        const XmlSax::String* begin,
+        const XmlSax::String* end,
+        bool trim,
+        bool unescape)
+    {
+        char buffer[256];
+        size_t size = 0;
+        // White spaces not written yet, and whether anything was written
+        bool space = false;
+        bool started = false;
+
+        for (const XmlSax::String* s = begin; s != end; ++s)
+        {
+            const char* pos = s->first;
+            while (pos != s->second)
+            {
+                if (size + 2 >= sizeof(buffer))
+                {
+                    context.update(buffer, size);
+                    size = 0;
+                }
+
+                if (isSpace(*pos))
+                {
+                    space = true;
+                    ++pos;
+                    continue;
+                }
+                if (space && (started || !trim))
+                    buffer[size++] = ' ';
+                space = false;
+                started = true;
+
+                char c = *pos++;
+                if (c == '&' && unescape)
+                    pos += XmlSax::unescape(pos, s->second, c);
+                buffer[size++] = c;
+            }
+        }
+        if (space && !trim)
+            buffer[size++] = ' ';
+        context.update(buffer, size);
+    }
+
+private: // types
+    typedef std::pair<XmlSax::String, XmlSax::String> Attribute;
+
+private: // data
+    Algorithm m_algorithm;
+    // Hashes of the open elements; [0] is the document's
+    std::vector<xmlsaxhash::Context> m_contexts;
+    size_t m_depth;
+    // Attributes of the current start tag
+    std::vector<Attribute> m_attributes;
+    // Text chunks of the current element not hashed yet
+    std::vector<XmlSax::String> m_text;
+};
+} // headeronly
+
+#endif // HO_SAX_HASHER_HPP_
@@ -0,0 +1,659 @@
+/*
+MIT License
+
+Copyright (c) 2016 Maciej Kalinski https://github.com/rumcays
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+/*
+    @file  ho_sax_index.hpp
+
+    @description
+    This is a part of header-only (see: wiki Header-only) tiny utils library.
+
+    Sidecar offset index: random access to the records of a huge document.
+    The index is built in one XmlSax pass. It holds an entry for each
+    element matching the path (e.g. "/export/record"; "*" matches any
+    name): byte offset and length of the element, its depth, the value of
+    an optional key attribute, and offsets of the ancestors' start tags.
+    Entries are looked up by the key or by the offset in O(log n).
+    parseAt() parses just the entry's subtree, reading only its bytes;
+    ancestor start tags may be passed to the visitor first, so it gets
+    the same context (enter(), attribute() events) as in the full parse.
+
+    The index is saved into a binary blob, with integers in the native
+    byte order - it's meant to be stored beside the document. Reading and
+    writing the blob is up to the client. The document may be passed to
+    parseAt() as memory (e.g. a memory mapped file), or as a C file;
+    in the latter case only the needed bytes are read.
+
+    Usage:
+        XmlSaxIndex index;
+        index.build(doc, "/export/record", "id");
+        index.save(blob);
+        ...
+        index.load(blob.data(), blob.size());
+        const XmlSaxIndex::Entry* entry = index.find("1234");
+        if (entry)
+            index.parseAt(file, *entry, visitor);
+*/
+
+#ifndef HO_SAX_INDEX_HPP_
+#define HO_SAX_INDEX_HPP_
+
+#include <cstdio>
+#include "ho_sax.hpp"
+
+namespace headeronly
+{
+class XmlSaxIndex
+{
+public: // types
+    struct Entry
+    {
+        /// Position of the element's '<' in the document
+        uint64_t offset;
+        /// Size of the element, with its subtree
+        uint64_t length;
+        /// Root element's depth is 1
+        uint32_t depth;
+        /// Key attribute value, normalized by XmlSax::toStringText()
+        std::string key;
+        /// Offsets of the ancestors' start tags, from the root
+        std::vector<uint64_t> ancestors;
+    };
+
+public: // constructors
+    XmlSaxIndex():
+        m_docSize(0)
+    {}
+
+public: // function members
+    // Index elements of doc matching path; path is absolute, names
+    // separated by '/'. If keyAttribute is not empty, values of that
+    // attribute are stored as the entries' keys.
+    // Return false if parsing failed; the index is left empty in such case.
+    bool build(
+        const char* doc,
+        const std::string& path,
+        const std::string& keyAttribute = std::string())
+    {
+        assert(doc);
+
+        clear();
+        m_path = path;
+        m_keyAttribute = keyAttribute;
+
+        Builder builder(*this, doc);
+        if (!XmlSax(builder).parse(doc))
+        {
+            clear();
+            return false;
+        }
+
+        m_docSize = strlen(doc);
+        sortKeys();
+        return true;
+    }
+
+    void clear()
+    {
+        m_docSize = 0;
+        m_path.clear();
+        m_keyAttribute.clear();
+        m_entries.clear();
+        m_byKey.clear();
+    }
+
+    // Entries in the document order
+    const std::vector<Entry>& entries() const
+    {
+        return m_entries;
+    }
+
+    // Size of the indexed document; a cheap check whether the index is
+    // stale
+    uint64_t docSize() const
+    {
+        return m_docSize;
+    }
+
+    // Return the first entry (in the document order) with the key,
+    // or nullptr
+    const Entry* find(const std::string& key) const
+    {
+        const auto it = std::lower_bound(m_byKey.begin(), m_byKey.end(), key,
+            [this](size_t index, const std::string& k){
+                return m_entries[index].key < k;});
+        return it != m_byKey.end() && m_entries[*it].key == key ?
+            &m_entries[*it] : nullptr;
+    }
+
+    // Return the entry of the indexed element containing offset,
+    // or nullptr. All the entries are at the path's depth, so they
+    // don't nest: only the last one starting at or before offset
+    // may contain it.
+    const Entry* findOffset(uint64_t offset) const
+    {
+        const auto last = std::upper_bound(m_entries.begin(), m_entries.end(),
+            offset, [](uint64_t o, const Entry& e){ return o < e.offset; });
+        if (last == m_entries.begin())
+            return nullptr;
+        const Entry& entry = *(last - 1);
+        return offset - entry.offset < entry.length ? &entry : nullptr;
+    }
+
+    // Parse the entry's subtree of doc (the document the index has been
+    // built for; it need not be null-terminated, e.g. memory mapped);
+    // if withAncestors, the visitor gets the ancestors' enter(),
+    // attribute() events before, and their exit() events after it.
+    // Error positions point into doc.
+    // Return false if parsing failed, or a callback function returned false.
+    bool parseAt(
+        const char* doc,
+        const Entry& entry,
+        XmlSax::Visitor& visitor,
+        bool withAncestors = true) const
+    {
+        assert(doc);
+
+        // An offset of a stale index need not point to a start tag
+        std::vector<XmlSax::String> names;
+        if (withAncestors)
+        {
+            for (auto offset : entry.ancestors)
+            {
+                const char* const tag = doc + offset;
+                const char* const end = startTagEnd(tag, doc + m_docSize);
+                std::string buffer(tag, end ? end : doc + m_docSize);
+                names.push_back(XmlSax::String());
+                if (!nameOf(tag, end, names.back()) ||
+                    !enterAncestor(buffer, tag, visitor))
+                    return false;
+            }
+        }
+
+        const char* const element = doc + entry.offset;
+        std::string buffer(element, static_cast<size_t>(entry.length));
+        Relocator relocator(visitor, buffer.c_str(), element);
+        if (!XmlSax(relocator).parse(buffer.c_str()))
+            return false;
+
+        return exitAncestors(names, visitor);
+    }
+
+    // As above, reading the needed parts of the document from file
+    bool parseAt(
+        FILE* file,
+        const Entry& entry,
+        XmlSax::Visitor& visitor,
+        bool withAncestors = true) const
+    {
+        assert(file);
+
+        // Error positions refer to the buffers, as there is no document
+        std::string buffer;
+        std::vector<std::string> names;
+        if (withAncestors)
+        {
+            for (auto offset : entry.ancestors)
+            {
+                XmlSax::String name;
+                if (!readStartTag(file, offset, buffer) ||
+                    !nameOf(buffer.c_str(), buffer.c_str() + buffer.size(), name))
+                    return false;
+                names.push_back(XmlSax::toStringName(name));
+                if (!enterAncestor(buffer, buffer.c_str(), visitor))
+                    return false;
+            }
+        }
+
+        buffer.resize(static_cast<size_t>(entry.length));
+        if (!seek(file, entry.offset) || buffer.empty() ||
+            fread(&buffer[0], 1, buffer.size(), file) != buffer.size())
+            return false;
+        if (!XmlSax(visitor).parse(buffer.c_str()))
+            return false;
+
+        for (auto it = names.rbegin(); it != names.rend(); ++it)
+        {
+            const char* const name = it->c_str();
+            if (!visitor.exit(XmlSax::String(name, name + it->size()), false))
+                return false;
+        }
+        return true;
+    }
+
+    // Serialize the index
+    void save(std::string& blob) const
+    {
+        blob.clear();
+        put(blob, static_cast<uint32_t>(Magic));
+        put(blob, static_cast<uint32_t>(Version));
+        put(blob, m_docSize);
+        putString(blob, m_path);
+        putString(blob, m_keyAttribute);
+        put(blob, static_cast<uint64_t>(m_entries.size()));
+        for (const auto& e : m_entries)
+        {
+            put(blob, e.offset);
+            put(blob, e.length);
+            put(blob, e.depth);
+            putString(blob, e.key);
+            put(blob, static_cast<uint32_t>(e.ancestors.size()));
+            for (auto offset : e.ancestors)
+                put(blob, offset);
+        }
+    }
+
+    // Deserialize the index.
+    // Return false if the blob is damaged; the index is left empty then.
+    bool load(const char* blob, size_t size)
+    {
+        assert(blob || !size);
+
+        clear();
+        const char* pos = blob;
+        const char* const end = blob + size;
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        uint64_t count = 0;
+
+        bool retCode = get(pos, end, magic) && magic == Magic &&
+            get(pos, end, version) && version == Version &&
+            get(pos, end, m_docSize) &&
+            getString(pos, end, m_path) &&
+            getString(pos, end, m_keyAttribute) &&
+            get(pos, end, count);
+
+        for (uint64_t n = 0; retCode && n < count; ++n)
+        {
+            Entry e;
+            uint32_t ancestors = 0;
+            retCode = get(pos, end, e.offset) &&
+                get(pos, end, e.length) &&
+                get(pos, end, e.depth) &&
+                getString(pos, end, e.key) &&
+                get(pos, end, ancestors) &&
+                // Not e.offset + e.length, which may overflow
+                e.offset <= m_docSize && e.length <= m_docSize - e.offset &&
+                // In the document order, not nested (see findOffset());
+                // the previous entry is within the document already
+                (m_entries.empty() ||
+                    e.offset >= m_entries.back().offset + m_entries.back().length) &&
+                // Each ancestor's offset takes 8 bytes
+                static_cast<size_t>(end - pos) / sizeof(uint64_t) >= ancestors;
+            for (uint32_t a = 0; retCode && a < ancestors; ++a)
+            {
+                e.ancestors.push_back(0);
+                retCode = get(pos, end, e.ancestors.back()) &&
+                    e.ancestors.back() < e.offset;
+            }
+            if (retCode)
+                m_entries.push_back(std::move(e));
+        }
+
+        if (!retCode || pos != end)
+        {
+            clear();
+            return false;
+        }
+
+        sortKeys();
+        return true;
+    }
+
+    const std::string& path() const
+    {
+        return m_path;
+    }
+
+    const std::string& keyAttribute() const
+    {
+        return m_keyAttribute;
+    }
+
+private: // types
+    enum
+    {
+        Magic = 0x49534f48, // "HOSI"
+        Version = 1
+    };
+
+    // Records the entries while parsing
+    struct Builder : XmlSax::Visitor
+    {
+        Builder(XmlSaxIndex& index, const char* doc):
+            m_index(index),
+            m_doc(doc),
+            m_lastPos(doc),
+            m_current(nullptr)
+        {
+            // Split the path into names
+            for (size_t begin = 0; begin < index.m_path.size();)
+            {
+                size_t end = index.m_path.find('/', begin);
+                if (end == std::string::npos)
+                    end = index.m_path.size();
+                if (end > begin)
+                    m_path.push_back(index.m_path.substr(begin, end - begin));
+                begin = end + 1;
+            }
+        }
+
+        virtual bool enter(const XmlSax::String& element, bool)
+        {
+            // '<' precedes the name
+            const uint64_t offset =
+                static_cast<uint64_t>(element.first - 1 - m_doc);
+            m_lastPos = element.second;
+
+            m_current = nullptr;
+            if (matches(element))
+            {
+                Entry e;
+                e.offset = offset;
+                e.length = 0;
+                e.depth = static_cast<uint32_t>(m_stack.size() + 1);
+                e.ancestors.reserve(m_stack.size());
+                for (const auto& node : m_stack)
+                    e.ancestors.push_back(node.offset);
+                m_index.m_entries.push_back(std::move(e));
+                m_current = &m_index.m_entries.back();
+            }
+
+            const Node node = { offset, element, m_current ?
+                m_index.m_entries.size() : 0 };
+            m_stack.push_back(node);
+            return true;
+        }
+        virtual bool exit(const XmlSax::String& element, bool isEmptyElementTag)
+        {
+            assert(!m_stack.empty());
+
+            // After "/>" of the start tag, or '>' of the end tag
+            const char* const end = strchr(
+                isEmptyElementTag ? m_lastPos : element.second, '>');
+            assert(end);
+
+            const Node& node = m_stack.back();
+            if (node.entry)
+            {
+                Entry& e = m_index.m_entries[node.entry - 1];
+                e.length = static_cast<uint64_t>(end + 1 - m_doc) - e.offset;
+            }
+            m_stack.pop_back();
+            m_current = nullptr;
+            return true;
+        }
+        virtual bool attribute(
+            const XmlSax::String& name,
+            const XmlSax::String& value)
+        {
+            // value is followed by the closing quote
+            m_lastPos = value.second;
+            if (m_current && !m_index.m_keyAttribute.empty() &&
+                m_current->key.empty() &&
+                equal(name, m_index.m_keyAttribute))
+            {
+                m_current->key = XmlSax::toStringText(value);
+            }
+            return true;
+        }
+
+        bool matches(const XmlSax::String& element) const
+        {
+            if (m_stack.size() + 1 != m_path.size())
+                return false;
+            for (size_t n = 0; n < m_path.size(); ++n)
+            {
+                const XmlSax::String& name =
+                    n < m_stack.size() ? m_stack[n].name : element;
+                if (m_path[n] != "*" &&
+                    !equal(name, m_path[n]))
+                    return false;
+            }
+            return true;
+        }
+
+        struct Node
+        {
+            uint64_t offset;
+            XmlSax::String name;
+            // Index of the element's entry + 1, or 0 if not indexed
+            size_t entry;
+        };
+
+        XmlSaxIndex& m_index;
+        const char* m_doc;
+        std::vector<std::string> m_path;
+        std::vector<Node> m_stack;
+        // End of the last name or attribute value in a start tag
+        const char* m_lastPos;
+        // Entry of the element whose attributes are being parsed
+        Entry* m_current;
+    };
+
+    // Shifts error positions and spans from the buffer to the document
+    struct Relocator : XmlSax::Visitor
+    {
+        Relocator(XmlSax::Visitor& visitor, const char* buffer, const char* doc):
+            m_visitor(visitor),
+            m_buffer(buffer),
+            m_doc(doc),
+            m_ancestor(false)
+        {}
+
+        virtual bool enter(const XmlSax::String& element, bool isEmptyElementTag)
+        { return m_visitor.enter(element, isEmptyElementTag && !m_ancestor); }
+        // Ancestor's start tag is parsed as an empty element
+        virtual bool exit(const XmlSax::String& element, bool isEmptyElementTag)
+        { return m_ancestor || m_visitor.exit(element, isEmptyElementTag); }
+        virtual bool attribute(
+            const XmlSax::String& name,
+            const XmlSax::String& value)
+        { return m_visitor.attribute(name, value); }
+        virtual bool text(const XmlSax::String& content)
+        { return m_visitor.text(content); }
+        virtual bool cdata(const XmlSax::String& content)
+        { return m_visitor.cdata(content); }
+        virtual bool span(
+            const XmlSax::String& element,
+            const XmlSax::String& outer,
+            const XmlSax::String& inner)
+        {
+            return m_ancestor ||
+                m_visitor.span(relocate(element), relocate(outer), relocate(inner));
+        }
+        virtual void error(const char* info, const char* docPos)
+        { m_visitor.error(info, m_doc + (docPos - m_buffer)); }
+        virtual bool validate()
+        { return m_visitor.validate(); }
+        virtual bool utf8()
+        { return m_visitor.utf8(); }
+        virtual bool spans()
+        { return m_visitor.spans(); }
+
+        XmlSax::String relocate(const XmlSax::String& s) const
+        {
+            return XmlSax::String(
+                m_doc + (s.first - m_buffer), m_doc + (s.second - m_buffer));
+        }
+
+        XmlSax::Visitor& m_visitor;
+        const char* m_buffer;
+        const char* m_doc;
+        bool m_ancestor;
+    };
+
+private: // functions
+    void sortKeys()
+    {
+        m_byKey.clear();
+        if (m_keyAttribute.empty())
+            return;
+
+        m_byKey.reserve(m_entries.size());
+        for (size_t n = 0; n < m_entries.size(); ++n)
+            m_byKey.push_back(n);
+        std::stable_sort(m_byKey.begin(), m_byKey.end(),
+            [this](size_t i1, size_t i2){
+                return m_entries[i1].key < m_entries[i2].key;});
+    }
+
+    // Pass the ancestor's start tag (in buffer) events to visitor;
+    // tag is the tag's position reported on errors
+    static bool enterAncestor(
+        std::string& buffer,
+        const char* tag,
+        XmlSax::Visitor& visitor)
+    {
+        // Parse the start tag as an empty element
+        if (buffer.size() > 1 && buffer[buffer.size() - 2] != '/')
+            buffer.insert(buffer.size() - 1, 1, '/');
+
+        Relocator relocator(visitor, buffer.c_str(), tag);
+        relocator.m_ancestor = true;
+        return XmlSax(relocator).parse(buffer.c_str());
+    }
+
+    static bool exitAncestors(
+        const std::vector<XmlSax::String>& names,
+        XmlSax::Visitor& visitor)
+    {
+        for (auto it = names.rbegin(); it != names.rend(); ++it)
+        {
+            if (!visitor.exit(*it, false))
+                return false;
+        }
+        return true;
+    }
+
+    // Element name of the start tag [pos, end).
+    // Return false if there is no start tag (e.g. for a stale index).
+    static bool nameOf(const char* pos, const char* end, XmlSax::String& name)
+    {
+        if (!pos || !end || pos == end || *pos != '<')
+            return false;
+        const char* nameEnd = ++pos;
+        while (nameEnd != end && !isspace(static_cast<unsigned char>(*nameEnd)) &&
+            *nameEnd != '>' && *nameEnd != '/')
+            ++nameEnd;
+        name = XmlSax::String(pos, nameEnd);
+        return pos != nameEnd;
+    }
+
+    static bool equal(const XmlSax::String& s1, const std::string& s2)
+    {
+        return static_cast<size_t>(s1.second - s1.first) == s2.size() &&
+            !s2.compare(0, s2.size(), s1.first, s2.size());
+    }
+
+    // Position right after the start tag at pos, or nullptr if it does not
+    // end before end; quoted attribute values may contain '>'
+    static const char* startTagEnd(const char* pos, const char* end)
+    {
+        bool quoted = false;
+        for (; pos != end; ++pos)
+        {
+            if (*pos == '"')
+                quoted = !quoted;
+            else if (*pos == '>' && !quoted)
+                return pos + 1;
+        }
+        return nullptr;
+    }
+
+    static bool seek(FILE* file, uint64_t offset)
+    {
+#if defined(_WIN32)
+        return !_fseeki64(file, static_cast<__int64>(offset), SEEK_SET);
+#else
+        return !fseeko(file, static_cast<off_t>(offset), SEEK_SET);
+#endif
+    }
+
+    // Read the start tag at offset into buffer, in growing chunks
+    static bool readStartTag(FILE* file, uint64_t offset, std::string& buffer)
+    {
+        for (size_t size = 256;; size *= 2)
+        {
+            buffer.assign(size, '\0');
+            if (!seek(file, offset))
+                return false;
+            buffer.resize(fread(&buffer[0], 1, size, file));
+
+            const char* const begin = buffer.c_str();
+            const char* const end = startTagEnd(begin, begin + buffer.size());
+            if (end)
+            {
+                buffer.resize(static_cast<size_t>(end - begin));
+                return true;
+            }
+            if (buffer.size() < size)
+                return false; // end of file
+        }
+    }
+
+    template <typename T>
+    static void put(std::string& blob, T value)
+    {
+        blob.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    static void putString(std::string& blob, const std::string& s)
+    {
+        put(blob, static_cast<uint32_t>(s.size()));
+        blob.append(s);
+    }
+
+    template <typename T>
+    static bool get(const char*& pos, const char* end, T& value)
+    {
+        if (static_cast<size_t>(end - pos) < sizeof(value))
+            return false;
+        memcpy(&value, pos, sizeof(value));
+        pos += sizeof(value);
+        return true;
+    }
+
+    static bool getString(const char*& pos, const char* end, std::string& s)
+    {
+        uint32_t length = 0;
+        if (!get(pos, end, length) ||
+            static_cast<size_t>(end - pos) < length)
+            return false;
+        s.assign(pos, length);
+        pos += length;
+        return true;
+    }
+
+private: // data
+    uint64_t m_docSize;
+    std::string m_path;
+    std::string m_keyAttribute;
+    std::vector<Entry> m_entries;
+    // Indexes of m_entries sorted by the key
+    std::vector<size_t> m_byKey;
+};
+} // headeronly
+
+#endif // HO_SAX_INDEX_HPP_
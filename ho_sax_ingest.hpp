@@ -0,0 +1,315 @@
+/*
+MIT License
+
+Copyright (c) 2016 Maciej Kalinski https://github.com/rumcays
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+/*
+    @file  ho_sax_ingest.hpp
+
+    @description
+    This is a part of header-only (see: wiki Header-only) tiny utils library.
+
+    Bulk parsing of many files, with reading overlapped with parsing.
+    Reader threads load whole files into buffers taken from a bounded
+    pool; parser threads (workers) parse the filled buffers, each with its
+    own visitor, and return the buffers to the pool. The number of readers
+    is the disk queue depth; the number of buffers bounds the memory
+    (buffers keep their capacity, so after warming up there are no
+    allocations for the file contents).
+    Files are parsed in no particular order; visitor's begin() and end()
+    callbacks delimit the events of one file. Visitors are called from
+    their workers' threads only, so they need no synchronization unless
+    they share data. Each worker reuses its parser for all its files.
+
+    The reading function may be replaced, e.g. to read from an archive.
+    An exception thrown by the reading function fails the file's read,
+    and one thrown by the visitor fails its parse; other files are
+    processed as usual.
+
+    Usage:
+        struct Counter : XmlSaxIngest::Visitor { ... };
+        std::vector<Counter> counters(4);
+        std::vector<XmlSaxIngest::Visitor*> visitors;
+        for (auto& c : counters)
+            visitors.push_back(&c);
+        XmlSaxIngest ingest(visitors);
+        ingest.run(paths);
+*/
+
+#ifndef HO_SAX_INGEST_HPP_
+#define HO_SAX_INGEST_HPP_
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "ho_sax.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+namespace headeronly
+{
+class XmlSaxIngest
+{
+public: // types
+    enum Result
+    {
+        Parsed,
+        ParseFailed,
+        ReadFailed,
+        Skipped
+    };
+
+    /// Worker's visitor
+    struct Visitor : XmlSax::Visitor
+    {
+        /// Called before parsing the file; return false to skip it
+        virtual bool begin(const std::string& /*path*/)
+        { return true; }
+        /// Called after the file has been parsed, or could not be
+        virtual void end(const std::string& /*path*/, Result /*result*/)
+        {}
+    };
+
+    /// Read the whole file into buffer (its memory should be reused);
+    /// return false on failure
+    typedef std::function<bool(const std::string& path, std::string& buffer)>
+        Reader;
+
+public: // constructors
+    // One worker per visitor; buffers == 0 means readers + workers
+    XmlSaxIngest(
+        const std::vector<Visitor*>& visitors,
+        size_t readers = 4,
+        size_t buffers = 0,
+        const Reader& reader = readFile):
+        m_visitors(visitors),
+        m_readers(readers ? readers : 1),
+        m_buffers(buffers ? buffers : m_readers + visitors.size()),
+        m_reader(reader),
+        m_paths(nullptr),
+        m_next(0),
+        m_activeReaders(0),
+        m_parsed(0)
+    {
+        assert(!m_visitors.empty());
+    }
+
+public: // function members
+    // Parse the files; return the number of successfully parsed ones
+    size_t run(const std::vector<std::string>& paths)
+    {
+        m_paths = &paths;
+        m_next = 0;
+        m_activeReaders = m_readers;
+        m_parsed = 0;
+        m_pool.resize(m_buffers);
+        for (size_t n = 0; n < m_pool.size(); ++n)
+            m_free.push_back(&m_pool[n]);
+
+        std::vector<std::thread> threads;
+        for (size_t n = 0; n < m_readers; ++n)
+            threads.push_back(std::thread(&XmlSaxIngest::read, this));
+        for (size_t n = 0; n < m_visitors.size(); ++n)
+            threads.push_back(std::thread(&XmlSaxIngest::parse, this, n));
+        for (auto& t : threads)
+            t.join();
+
+        assert(m_ready.empty() && m_free.size() == m_pool.size());
+        m_free.clear();
+        m_paths = nullptr;
+        return m_parsed;
+    }
+
+    // Default reader: the whole file, with positioned reads on POSIX
+    static bool readFile(const std::string& path, std::string& buffer)
+    {
+#ifdef _WIN32
+        FILE* const file = fopen(path.c_str(), "rb");
+        if (!file)
+            return false;
+        buffer.clear();
+        char chunk[64 * 1024];
+        size_t size = 0;
+        while ((size = fread(chunk, 1, sizeof(chunk), file)) > 0)
+            buffer.append(chunk, size);
+        const bool ok = !ferror(file);
+        fclose(file);
+        return ok;
+#else
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        bool ok = !fstat(fd, &st);
+        if (ok)
+        {
+            buffer.resize(static_cast<size_t>(st.st_size));
+            size_t size = 0;
+            while (ok && size < buffer.size())
+            {
+                const ssize_t read = pread(fd, &buffer[size],
+                    buffer.size() - size, static_cast<off_t>(size));
+                if (read > 0)
+                    size += static_cast<size_t>(read);
+                else if (!read)
+                    buffer.resize(size); // truncated meanwhile
+                else
+                    ok = errno == EINTR;
+            }
+        }
+        close(fd);
+        return ok;
+#endif // _WIN32
+    }
+
+private: // types
+    struct Job
+    {
+        size_t file;
+        std::string* buffer;
+        bool ok;
+    };
+
+private: // functions
+    // Reader thread: fill free buffers with the next files
+    void read()
+    {
+        for (;;)
+        {
+            std::string* buffer = nullptr;
+            size_t file = 0;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (m_next == m_paths->size())
+                    break;
+                m_bufferFree.wait(lock, [this]{
+                    return !m_free.empty() || m_next == m_paths->size(); });
+                if (m_next == m_paths->size())
+                    break;
+                file = m_next++;
+                buffer = m_free.back();
+                m_free.pop_back();
+            }
+
+            Job job = { file, buffer, false };
+            try
+            {
+                job.ok = m_reader((*m_paths)[file], *buffer);
+            }
+            catch (...)
+            {
+                // e.g. std::bad_alloc for a big file
+                job.ok = false;
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_ready.push_back(job);
+            m_jobReady.notify_one();
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_activeReaders;
+        m_jobReady.notify_all();
+        // Other readers may wait for a buffer while no files are left
+        m_bufferFree.notify_all();
+    }
+
+    // Worker thread: parse the read files
+    void parse(size_t worker)
+    {
+        Visitor& visitor = *m_visitors[worker];
+        XmlSax sax(visitor);
+        for (;;)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_jobReady.wait(lock, [this]{
+                    return !m_ready.empty() || !m_activeReaders; });
+                if (m_ready.empty())
+                    break;
+                job = m_ready.front();
+                m_ready.pop_front();
+            }
+
+            const std::string& path = (*m_paths)[job.file];
+            Result result = Skipped;
+            try
+            {
+                if (!job.ok)
+                    result = ReadFailed;
+                else if (visitor.begin(path))
+                    result = sax.parse(job.buffer->c_str()) ? Parsed : ParseFailed;
+            }
+            catch (...)
+            {
+                // Thrown by the visitor; the next file is parsed anew
+                result = ParseFailed;
+            }
+            try
+            {
+                visitor.end(path, result);
+            }
+            catch (...)
+            {
+                result = ParseFailed;
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (result == Parsed)
+                ++m_parsed;
+            m_free.push_back(job.buffer);
+            m_bufferFree.notify_one();
+        }
+    }
+
+private: // data
+    std::vector<Visitor*> m_visitors;
+    size_t m_readers;
+    size_t m_buffers;
+    Reader m_reader;
+
+    // State of run(), guarded by m_mutex
+    std::mutex m_mutex;
+    std::condition_variable m_bufferFree;
+    std::condition_variable m_jobReady;
+    const std::vector<std::string>* m_paths;
+    size_t m_next;
+    size_t m_activeReaders;
+    size_t m_parsed;
+    std::deque<std::string> m_pool;
+    std::vector<std::string*> m_free;
+    std::deque<Job> m_ready;
+};
+} // headeronly
+
+#endif // HO_SAX_INGEST_HPP_
@@ -0,0 +1,410 @@
+/*
+MIT License
+
+Copyright (c) 2016 Maciej Kalinski https://github.com/rumcays
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+    @file  ho_sax_namespace.hpp
+
+    @description
+    This is a part of header-only (see: wiki Header-only) tiny utils library.
+
+    Namespace resolution layer: a visitor between the parser and the client's
+    XmlSaxNamespaces::Visitor, passing element and attribute names resolved
+    to (namespace ID, local name).
+    Namespace URIs are interned: each distinct URI gets an integer ID, stable
+    for the lifetime of the resolver object, so the client compares IDs
+    instead of strings (see intern(), uri()). Predefined IDs:
+    * NoNamespace - unprefixed names without default namespace,
+      and unprefixed attributes
+    * XmlNamespace - "xml" prefix
+    * XmlnsNamespace - namespace declarations (xmlns, xmlns:prefix)
+
+    Bindings are kept in a scoped stack: declarations of an element are
+    pushed when it's entered, and popped in its exit. Since declarations
+    are attributes of the element, the enter() callback is deferred until
+    all the attributes have been received.
+    Names are spans of the document, as for XmlSax::Visitor; the stacks
+    reuse their memory, so there are no allocations per element (only
+    for a new URI, and when a stack grows).
+
+    Usage:
+        struct Envelope : XmlSaxNamespaces::Visitor { ... };
+        Envelope envelope;
+        XmlSaxNamespaces resolver(envelope);
+        envelope.m_soap = resolver.intern("http://www.w3.org/2003/05/soap-envelope");
+        XmlSax(resolver).parse(doc);
+*/
+
+#ifndef HO_SAX_NAMESPACE_HPP_
+#define HO_SAX_NAMESPACE_HPP_
+
+#include <unordered_map>
+#include "ho_sax.hpp"
+
+namespace headeronly
+{
+class XmlSaxNamespaces : public XmlSax::Visitor
+{
+public: // types
+    enum
+    {
+        NoNamespace = 0,
+        XmlNamespace = 1,
+        XmlnsNamespace = 2
+    };
+
+    /// Resolved name
+    struct Name
+    {
+        /// Namespace ID, see uri()
+        size_t ns;
+        /// Name without prefix
+        XmlSax::String local;
+        /// Name as in the document
+        XmlSax::String qualified;
+    };
+
+    /// Callbacks with resolved names; remaining ones as in XmlSax::Visitor
+    struct Visitor
+    {
+        virtual ~Visitor() {}
+
+        virtual bool enter(const Name& /*element*/, bool /*isEmptyElementTag*/)
+        { return true; }
+        virtual bool exit(const Name& /*element*/, bool /*isEmptyElementTag*/)
+        { return true; }
+        virtual bool attribute(
+            const Name& /*name*/,
+            const XmlSax::String& /*value*/)
+        { return true; }
+        virtual bool text(const XmlSax::String& /*content*/)
+        { return true; }
+        virtual bool cdata(const XmlSax::String& /*content*/)
+        { return true; }
+        virtual bool doctype(const XmlSax::String& /*declarations*/)
+        { return true; }
+        virtual bool fragment(const XmlSax::String& /*fragment*/)
+        { return true; }
+        virtual bool span(
+            const Name& /*element*/,
+            const XmlSax::String& /*outer*/,
+            const XmlSax::String& /*inner*/)
+        { return true; }
+        virtual void error(const char* /*info*/, const char* /*docPos*/)
+        {}
+        virtual bool validate()
+        { return false; }
+        virtual bool utf8()
+        { return false; }
+        virtual bool spans()
+        { return false; }
+    };
+
+public: // constructors
+    XmlSaxNamespaces(Visitor& next):
+        m_next(next),
+        m_pending(false),
+        m_isEmptyElementTag(false)
+    {
+        intern("");
+        intern("http://www.w3.org/XML/1998/namespace");
+        intern("http://www.w3.org/2000/xmlns/");
+        reset();
+    }
+
+public: // function members
+    // ID of the namespace URI; registers the URI if it's new
+    size_t intern(const std::string& uri)
+    {
+        m_value = uri;
+        return internValue();
+    }
+
+    // URI of the namespace ID
+    const std::string& uri(size_t ns) const
+    {
+        assert(ns < m_uris.size());
+        return m_uris[ns];
+    }
+
+    // Forget the bindings and the deferred element, e.g. when parsing
+    // has failed and the resolver is reused for another document;
+    // interned URIs are kept.
+    void reset()
+    {
+        static const char* const xml = "xml";
+        m_pending = false;
+        m_attributes.clear();
+        m_scopes.clear();
+        m_bindings.clear();
+        const Binding binding = { XmlSax::String(xml, xml + 3), XmlNamespace };
+        m_bindings.push_back(binding);
+    }
+
+    virtual bool enter(const XmlSax::String& element, bool isEmptyElementTag)
+    {
+        if (!flush())
+            return false;
+
+        m_pending = true;
+        m_element = element;
+        m_isEmptyElementTag = isEmptyElementTag;
+        m_attributes.clear();
+        return true;
+    }
+    virtual bool exit(const XmlSax::String& element, bool isEmptyElementTag)
+    {
+        if (!flush())
+            return false;
+
+        assert(!m_scopes.empty());
+        const Scope scope = m_scopes.back();
+        m_scopes.pop_back();
+        m_bindings.resize(scope.bindings);
+
+        const Name name = { scope.ns, local(element), element };
+        return m_next.exit(name, isEmptyElementTag);
+    }
+    virtual bool attribute(
+        const XmlSax::String& name,
+        const XmlSax::String& value)
+    {
+        assert(m_pending);
+        m_attributes.push_back(std::make_pair(name, value));
+        return true;
+    }
+    virtual bool text(const XmlSax::String& content)
+    {
+        return flush() && m_next.text(content);
+    }
+    virtual bool cdata(const XmlSax::String& content)
+    {
+        return flush() && m_next.cdata(content);
+    }
+    virtual bool doctype(const XmlSax::String& declarations)
+    {
+        return m_next.doctype(declarations);
+    }
+    virtual bool fragment(const XmlSax::String& fragment)
+    {
+        return m_next.fragment(fragment);
+    }
+    virtual bool span(
+        const XmlSax::String& element,
+        const XmlSax::String& outer,
+        const XmlSax::String& inner)
+    {
+        if (!flush())
+            return false;
+
+        assert(!m_scopes.empty());
+        const Name name = { m_scopes.back().ns, local(element), element };
+        return m_next.span(name, outer, inner);
+    }
+    virtual void error(const char* info, const char* docPos)
+    {
+        m_next.error(info, docPos);
+    }
+    virtual bool validate()
+    {
+        return m_next.validate();
+    }
+    virtual bool utf8()
+    {
+        return m_next.utf8();
+    }
+    virtual bool spans()
+    {
+        return m_next.spans();
+    }
+
+private: // types
+    // Prefix bound to a namespace; empty prefix for the default namespace
+    struct Binding
+    {
+        XmlSax::String prefix;
+        size_t ns;
+    };
+
+    // Open element: namespace of its name, and the number of bindings
+    // before its declarations
+    struct Scope
+    {
+        size_t ns;
+        size_t bindings;
+    };
+
+private: // functions
+    // Pass the deferred element: bind its declarations, then resolve
+    // its name and its attributes' ones.
+    // Return false on an unbound prefix, or if stopped by a callback.
+    bool flush()
+    {
+        if (!m_pending)
+            return true;
+        m_pending = false;
+
+        const Scope scope = { NoNamespace, m_bindings.size() };
+        for (const auto& attribute : m_attributes)
+        {
+            const XmlSax::String& name = attribute.first;
+            const bool isDefault = equal(name, "xmlns");
+            if (!isDefault && !equal(prefix(name), "xmlns"))
+                continue;
+
+            XmlSax::toStringValue(attribute.second, m_value);
+            const Binding binding = {
+                isDefault ? XmlSax::String(name.second, name.second) : local(name),
+                internValue() };
+            // Only the default namespace may be undeclared
+            if (binding.ns == NoNamespace && !isDefault)
+                return reportError("ERROR: empty namespace URI: ", name);
+            m_bindings.push_back(binding);
+        }
+
+        m_scopes.push_back(scope);
+        if (!resolve(m_element, true, m_scopes.back().ns))
+            return false;
+
+        const Name element = { m_scopes.back().ns, local(m_element), m_element };
+        if (!m_next.enter(element, m_isEmptyElementTag))
+            return false;
+
+        for (const auto& attribute : m_attributes)
+        {
+            Name name = { NoNamespace, local(attribute.first), attribute.first };
+            if (!resolve(attribute.first, false, name.ns) ||
+                !m_next.attribute(name, attribute.second))
+                return false;
+        }
+        return true;
+    }
+
+    // Namespace of the name; unprefixed attributes are in no namespace.
+    // Return false on an unbound prefix.
+    bool resolve(const XmlSax::String& name, bool isElement, size_t& ns)
+    {
+        const XmlSax::String p = prefix(name);
+        if (equal(name, "xmlns") || equal(p, "xmlns"))
+        {
+            ns = XmlnsNamespace;
+            return true;
+        }
+        if (p.first == p.second && !isElement)
+        {
+            ns = NoNamespace;
+            return true;
+        }
+
+        for (auto it = m_bindings.rbegin(); it != m_bindings.rend(); ++it)
+        {
+            if (it->prefix.second - it->prefix.first == p.second - p.first &&
+                !memcmp(it->prefix.first, p.first,
+                    static_cast<size_t>(p.second - p.first)))
+            {
+                ns = it->ns;
+                return true;
+            }
+        }
+
+        if (p.first == p.second)
+        {
+            // No default namespace
+            ns = NoNamespace;
+            return true;
+        }
+        return reportError("ERROR: unbound namespace prefix: ", p);
+    }
+
+    // Prefix of the name; empty for an unprefixed one
+    static XmlSax::String prefix(const XmlSax::String& name)
+    {
+        const char* const colon = static_cast<const char*>(
+            memchr(name.first, ':', static_cast<size_t>(name.second - name.first)));
+        return XmlSax::String(name.first, colon ? colon : name.first);
+    }
+
+    static XmlSax::String local(const XmlSax::String& name)
+    {
+        const char* const colon = static_cast<const char*>(
+            memchr(name.first, ':', static_cast<size_t>(name.second - name.first)));
+        return XmlSax::String(colon ? colon + 1 : name.first, name.second);
+    }
+
+    static bool equal(const XmlSax::String& s1, const char* s2)
+    {
+        const size_t length = strlen(s2);
+        return static_cast<size_t>(s1.second - s1.first) == length &&
+            !memcmp(s1.first, s2, length);
+    }
+
+    // ID of the URI in m_value
+    size_t internValue()
+    {
+        const uint64_t key = XmlSax::hash(
+            XmlSax::String(m_value.data(), m_value.data() + m_value.size()));
+        const auto range = m_ids.equal_range(key);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (m_uris[it->second] == m_value)
+                return it->second;
+        }
+
+        m_uris.push_back(m_value);
+        m_ids.insert(std::make_pair(key, m_uris.size() - 1));
+        return m_uris.size() - 1;
+    }
+
+    bool reportError(const char* info, const XmlSax::String& name)
+    {
+        m_errorInfo.assign(info);
+        m_errorInfo += '"';
+        m_errorInfo.append(name.first, name.second);
+        m_errorInfo += '"';
+        m_next.error(m_errorInfo.c_str(), name.first);
+        return false;
+    }
+
+private: // data
+    Visitor& m_next;
+
+    // Interned URIs, indexed by ID, and IDs by the URIs' hashes
+    std::vector<std::string> m_uris;
+    std::unordered_multimap<uint64_t, size_t> m_ids;
+
+    std::vector<Binding> m_bindings;
+    std::vector<Scope> m_scopes;
+
+    // Element waiting for its attributes
+    bool m_pending;
+    XmlSax::String m_element;
+    bool m_isEmptyElementTag;
+    std::vector<std::pair<XmlSax::String, XmlSax::String> > m_attributes;
+
+    // Memory reused for URI values, and error messages
+    std::string m_value;
+    std::string m_errorInfo;
+};
+} // headeronly
+
+#endif // HO_SAX_NAMESPACE_HPP_
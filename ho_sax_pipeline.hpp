@@ -0,0 +1,429 @@
+/*
+MIT License
+
+Copyright (c) 2016 Maciej Kalinski https://github.com/rumcays
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+    @file  ho_sax_pipeline.hpp
+
+    @description
+    This is a part of header-only (see: wiki Header-only) tiny utils library.
+
+    Visitor compositions: the document is tokenized once, no matter how many
+    consumers are interested in it.
+
+    XmlSaxFanOut passes each event to many visitors. A visitor returning
+    false from a callback is stopped, while remaining ones continue; parsing
+    stops when all of them are stopped. A visitor may also call skip() from
+    its enter() callback, to not receive the content (children, text, CDATA)
+    of that element; its attributes and exit() are still passed.
+
+    Filters are visitors forwarding (modified) events to the next visitor,
+    so they may be chained between the parser and the final visitors:
+    * XmlSaxRename - renames elements
+    * XmlSaxDropElement - removes elements with their subtrees
+    * XmlSaxAttributeProjection - passes only the listed attributes
+
+    Usage:
+        XmlSaxFanOut fanOut;
+        XmlSaxDropElement drop(consumer2);
+        drop.add("Debug");
+        fanOut.add(consumer1).add(drop);
+        XmlSax(fanOut).parse(doc);
+*/
+
+#ifndef HO_SAX_PIPELINE_HPP_
+#define HO_SAX_PIPELINE_HPP_
+
+#include "ho_sax.hpp"
+
+namespace headeronly
+{
+namespace xmlsaxpipeline
+{
+inline bool equal(const XmlSax::String& s1, const std::string& s2)
+{
+    return static_cast<size_t>(s1.second - s1.first) == s2.size() &&
+        !s2.compare(0, s2.size(), s1.first, s2.size());
+}
+
+inline bool contains(
+    const std::vector<std::string>& names,
+    const XmlSax::String& name)
+{
+    for (const auto& n : names)
+    {
+        if (equal(name, n))
+            return true;
+    }
+    return false;
+}
+} // xmlsaxpipeline
+
+class XmlSaxFanOut : public XmlSax::Visitor
+{
+public: // constructors
+    XmlSaxFanOut():
+        m_active(0),
+        m_current(nullptr)
+    {}
+
+public: // function members
+    XmlSaxFanOut& add(XmlSax::Visitor& visitor)
+    {
+        Consumer consumer = { &visitor, true, 0 };
+        m_consumers.push_back(consumer);
+        ++m_active;
+        return *this;
+    }
+
+    // Called from a visitor's enter(): skip the content of the element
+    // for this visitor
+    void skip()
+    {
+        assert(m_current && "skip() called outside of enter()");
+        m_current->skipDepth = 1;
+    }
+
+    // Return false if the visitor has been stopped by returning false
+    bool isActive(size_t index) const
+    {
+        assert(index < m_consumers.size());
+        return m_consumers[index].active;
+    }
+
+    virtual bool enter(const XmlSax::String& element, bool isEmptyElementTag)
+    {
+        for (auto& c : m_consumers)
+        {
+            if (!c.active)
+                continue;
+            if (c.skipDepth)
+            {
+                ++c.skipDepth;
+                continue;
+            }
+
+            m_current = &c;
+            const bool retCode = c.visitor->enter(element, isEmptyElementTag);
+            m_current = nullptr;
+            if (!retCode)
+                stop(c);
+        }
+        return m_active > 0;
+    }
+    virtual bool exit(const XmlSax::String& element, bool isEmptyElementTag)
+    {
+        for (auto& c : m_consumers)
+        {
+            if (!c.active)
+                continue;
+            if (c.skipDepth > 1)
+            {
+                --c.skipDepth;
+                continue;
+            }
+
+            c.skipDepth = 0;
+            if (!c.visitor->exit(element, isEmptyElementTag))
+                stop(c);
+        }
+        return m_active > 0;
+    }
+    virtual bool attribute(
+        const XmlSax::String& name,
+        const XmlSax::String& value)
+    {
+        for (auto& c : m_consumers)
+        {
+            if (c.active && c.skipDepth <= 1 && !c.visitor->attribute(name, value))
+                stop(c);
+        }
+        return m_active > 0;
+    }
+    virtual bool text(const XmlSax::String& content)
+    {
+        for (auto& c : m_consumers)
+        {
+            if (c.active && !c.skipDepth && !c.visitor->text(content))
+                stop(c);
+        }
+        return m_active > 0;
+    }
+    virtual bool cdata(const XmlSax::String& content)
+    {
+        for (auto& c : m_consumers)
+        {
+            if (c.active && !c.skipDepth && !c.visitor->cdata(content))
+                stop(c);
+        }
+        return m_active > 0;
+    }
+    virtual bool doctype(const XmlSax::String& declarations)
+    {
+        for (auto& c : m_consumers)
+        {
+            if (c.active && !c.visitor->doctype(declarations))
+                stop(c);
+        }
+        return m_active > 0;
+    }
+    virtual bool fragment(const XmlSax::String& fragment)
+    {
+        for (auto& c : m_consumers)
+        {
+            if (c.active && !c.visitor->fragment(fragment))
+                stop(c);
+        }
+        return m_active > 0;
+    }
+    // Passed for a skipped element too, so its raw markup may be forwarded
+    virtual bool span(
+        const XmlSax::String& element,
+        const XmlSax::String& outer,
+        const XmlSax::String& inner)
+    {
+        for (auto& c : m_consumers)
+        {
+            if (c.active && c.skipDepth <= 1 &&
+                !c.visitor->span(element, outer, inner))
+                stop(c);
+        }
+        return m_active > 0;
+    }
+    virtual void error(const char* info, const char* docPos)
+    {
+        for (auto& c : m_consumers)
+        {
+            if (c.active)
+                c.visitor->error(info, docPos);
+        }
+    }
+    // Parser options are the sum of consumers' ones
+    virtual bool validate()
+    {
+        for (auto& c : m_consumers)
+        {
+            if (c.active && c.visitor->validate())
+                return true;
+        }
+        return false;
+    }
+    virtual bool utf8()
+    {
+        for (auto& c : m_consumers)
+        {
+            if (c.active && c.visitor->utf8())
+                return true;
+        }
+        return false;
+    }
+    virtual bool spans()
+    {
+        for (auto& c : m_consumers)
+        {
+            if (c.active && c.visitor->spans())
+                return true;
+        }
+        return false;
+    }
+
+private: // types
+    struct Consumer
+    {
+        XmlSax::Visitor* visitor;
+        bool active;
+        // 1: the skipped element itself, more: inside of it
+        size_t skipDepth;
+    };
+
+private: // functions
+    void stop(Consumer& c)
+    {
+        c.active = false;
+        --m_active;
+    }
+
+private: // data
+    std::vector<Consumer> m_consumers;
+    size_t m_active;
+    // Consumer inside of its enter() callback
+    Consumer* m_current;
+};
+
+/// Filter base: forwards all the events to the next visitor
+struct XmlSaxFilter : XmlSax::Visitor
+{
+    XmlSaxFilter(XmlSax::Visitor& next):
+        m_next(next)
+    {}
+
+    virtual bool enter(const XmlSax::String& element, bool isEmptyElementTag)
+    { return m_next.enter(element, isEmptyElementTag); }
+    virtual bool exit(const XmlSax::String& element, bool isEmptyElementTag)
+    { return m_next.exit(element, isEmptyElementTag); }
+    virtual bool attribute(
+        const XmlSax::String& name,
+        const XmlSax::String& value)
+    { return m_next.attribute(name, value); }
+    virtual bool text(const XmlSax::String& content)
+    { return m_next.text(content); }
+    virtual bool cdata(const XmlSax::String& content)
+    { return m_next.cdata(content); }
+    virtual bool doctype(const XmlSax::String& declarations)
+    { return m_next.doctype(declarations); }
+    virtual bool fragment(const XmlSax::String& fragment)
+    { return m_next.fragment(fragment); }
+    virtual bool span(
+        const XmlSax::String& element,
+        const XmlSax::String& outer,
+        const XmlSax::String& inner)
+    { return m_next.span(element, outer, inner); }
+    virtual void error(const char* info, const char* docPos)
+    { m_next.error(info, docPos); }
+    virtual bool validate()
+    { return m_next.validate(); }
+    virtual bool utf8()
+    { return m_next.utf8(); }
+    virtual bool spans()
+    { return m_next.spans(); }
+
+    XmlSax::Visitor& m_next;
+};
+
+/// Renames elements; new names are owned by the filter
+struct XmlSaxRename : XmlSaxFilter
+{
+    XmlSaxRename(XmlSax::Visitor& next):
+        XmlSaxFilter(next)
+    {}
+
+    XmlSaxRename& add(const std::string& from, const std::string& to)
+    {
+        m_names.push_back(std::make_pair(from, to));
+        return *this;
+    }
+
+    virtual bool enter(const XmlSax::String& element, bool isEmptyElementTag)
+    { return m_next.enter(rename(element), isEmptyElementTag); }
+    virtual bool exit(const XmlSax::String& element, bool isEmptyElementTag)
+    { return m_next.exit(rename(element), isEmptyElementTag); }
+    // Note: the raw markup keeps the original names
+    virtual bool span(
+        const XmlSax::String& element,
+        const XmlSax::String& outer,
+        const XmlSax::String& inner)
+    { return m_next.span(rename(element), outer, inner); }
+
+    XmlSax::String rename(const XmlSax::String& element) const
+    {
+        for (const auto& names : m_names)
+        {
+            if (xmlsaxpipeline::equal(element, names.first))
+            {
+                return XmlSax::String(names.second.data(),
+                    names.second.data() + names.second.size());
+            }
+        }
+        return element;
+    }
+
+    std::vector<std::pair<std::string, std::string> > m_names;
+};
+
+/// Removes elements of given names, with their subtrees
+struct XmlSaxDropElement : XmlSaxFilter
+{
+    XmlSaxDropElement(XmlSax::Visitor& next):
+        XmlSaxFilter(next),
+        m_depth(0)
+    {}
+
+    XmlSaxDropElement& add(const std::string& name)
+    {
+        m_names.push_back(name);
+        return *this;
+    }
+
+    virtual bool enter(const XmlSax::String& element, bool isEmptyElementTag)
+    {
+        if (m_depth || xmlsaxpipeline::contains(m_names, element))
+        {
+            ++m_depth;
+            return true;
+        }
+        return m_next.enter(element, isEmptyElementTag);
+    }
+    virtual bool exit(const XmlSax::String& element, bool isEmptyElementTag)
+    {
+        if (m_depth)
+        {
+            --m_depth;
+            return true;
+        }
+        return m_next.exit(element, isEmptyElementTag);
+    }
+    virtual bool attribute(
+        const XmlSax::String& name,
+        const XmlSax::String& value)
+    { return m_depth || m_next.attribute(name, value); }
+    virtual bool text(const XmlSax::String& content)
+    { return m_depth || m_next.text(content); }
+    virtual bool cdata(const XmlSax::String& content)
+    { return m_depth || m_next.cdata(content); }
+    virtual bool span(
+        const XmlSax::String& element,
+        const XmlSax::String& outer,
+        const XmlSax::String& inner)
+    { return m_depth || m_next.span(element, outer, inner); }
+
+    std::vector<std::string> m_names;
+    // Depth inside of a dropped element
+    size_t m_depth;
+};
+
+/// Passes only attributes of given names
+struct XmlSaxAttributeProjection : XmlSaxFilter
+{
+    XmlSaxAttributeProjection(XmlSax::Visitor& next):
+        XmlSaxFilter(next)
+    {}
+
+    XmlSaxAttributeProjection& add(const std::string& name)
+    {
+        m_names.push_back(name);
+        return *this;
+    }
+
+    virtual bool attribute(
+        const XmlSax::String& name,
+        const XmlSax::String& value)
+    {
+        return !xmlsaxpipeline::contains(m_names, name) ||
+            m_next.attribute(name, value);
+    }
+
+    std::vector<std::string> m_names;
+};
+} // headeronly
+
+#endif // HO_SAX_PIPELINE_HPP_
@@ -0,0 +1,894 @@
+/*
+MIT License
+
+Copyright (c) 2016 Maciej Kalinski https://github.com/rumcays
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+/*
+    @file  ho_sax_schema.hpp
+
+    @description
+    This is a part of header-only (see: wiki Header-only) tiny utils library.
+
+    Structural validation while parsing.
+    XmlSaxSchema holds element declarations: a content model over child
+    element names, and declared (optionally required) attributes.
+    Declarations are given programmatically, in the DTD syntax of content
+    models, or compiled from the document's <!ELEMENT> and <!ATTLIST>
+    declarations. Each content model is compiled into a DFA (Glushkov
+    automaton, then subset construction), so checking a child element
+    is one table lookup.
+
+    XmlSaxValidator is a filter checking the events against the schema
+    before forwarding them to the next visitor; the first violation is
+    reported by the next visitor's error(), and parsing stops.
+    Without a schema given, the validator uses the document's internal
+    DTD subset; documents without any declarations are not validated.
+
+    Supported content models: EMPTY, ANY, mixed "(#PCDATA|a|b)*",
+    and children "(a,(b|c)*,d?)+". White space text is allowed in element
+    content. Attribute types and default values are not checked;
+    #REQUIRED attributes have to be present, undeclared ones are errors.
+    Parameter entities are not supported.
+
+    Usage:
+        XmlSaxSchema schema;
+        schema.element("list", "(item+)");
+        schema.element("item", "(#PCDATA)");
+        schema.attribute("item", "id", true);
+        XmlSaxValidator validator(visitor, schema);
+        XmlSax(validator).parse(doc);
+*/
+
+#ifndef HO_SAX_SCHEMA_HPP_
+#define HO_SAX_SCHEMA_HPP_
+
+#include <map>
+#include <unordered_map>
+#include "ho_sax.hpp"
+#include "ho_sax_pipeline.hpp"
+
+namespace headeronly
+{
+class XmlSaxSchema
+{
+public: // types
+    enum ContentType
+    {
+        Empty,
+        Any,
+        Mixed,
+        Children
+    };
+
+    struct Attribute
+    {
+        std::string name;
+        bool required;
+    };
+
+    /// Compiled content model
+    struct Element
+    {
+        std::string name;
+        bool declared;
+        ContentType type;
+        // Child element ids occurring in the model, sorted
+        std::vector<uint32_t> symbols;
+        // [state * symbols.size() + symbol index] -> next state
+        std::vector<uint32_t> transitions;
+        std::vector<char> accepting;
+        std::vector<Attribute> attributes;
+        bool anyAttributes;
+    };
+
+    enum
+    {
+        NoState = 0xffffffff
+    };
+
+public: // function members
+    // Declare element's content model, e.g. "EMPTY", "ANY", "(#PCDATA)",
+    // "(#PCDATA|b|i)*", "(head,(p|list)*)".
+    // Return false on syntax error (see error()), or if already declared.
+    bool element(const std::string& name, const std::string& contentModel)
+    {
+        const char* const begin = contentModel.c_str();
+        return declare(name, begin, begin + contentModel.size());
+    }
+
+    // Declare an attribute of the element
+    bool attribute(
+        const std::string& element,
+        const std::string& name,
+        bool required = false)
+    {
+        Element& e = m_elements[id(element)];
+        for (const auto& a : e.attributes)
+        {
+            if (a.name == name)
+                return true; // the first declaration is binding
+        }
+        const Attribute a = { name, required };
+        e.attributes.push_back(a);
+        return true;
+    }
+
+    // Allow all attributes of the element
+    void anyAttributes(const std::string& element)
+    {
+        m_elements[id(element)].anyAttributes = true;
+    }
+
+    // Compile <!ELEMENT> and <!ATTLIST> declarations (a DTD internal
+    // subset); other declarations, comments and PIs are skipped.
+    // Return false on syntax error (see error()).
+    bool dtd(const XmlSax::String& declarations)
+    {
+        const char* pos = declarations.first;
+        const char* const end = declarations.second;
+
+        for (;;)
+        {
+            pos = skipSpaces(pos, end);
+            if (pos == end)
+                return true;
+
+            if (startsWith(pos, end, "<!--"))
+            {
+                pos = find(pos + 4, end, "-->");
+                if (!pos)
+                    return fail("unterminated comment");
+                pos += 3;
+            }
+            else if (startsWith(pos, end, "<!ELEMENT"))
+            {
+                const char* const close = find(pos, end, ">");
+                if (!close)
+                    return fail("unterminated <!ELEMENT>");
+                pos = skipSpaces(pos + 9, close);
+                std::string name;
+                if (!parseName(pos, close, name) || !declare(name, pos, close))
+                    return false;
+                pos = close + 1;
+            }
+            else if (startsWith(pos, end, "<!ATTLIST"))
+            {
+                pos += 9;
+                if (!attributeList(pos, end))
+                    return false;
+            }
+            else if (startsWith(pos, end, "<?"))
+            {
+                pos = find(pos, end, "?>");
+                if (!pos)
+                    return fail("unterminated processing instruction");
+                pos += 2;
+            }
+            else if (startsWith(pos, end, "<!"))
+            {
+                // ENTITY, NOTATION
+                pos = skipQuoted(pos, end, '>');
+                if (pos == end)
+                    return fail("unterminated declaration");
+                ++pos;
+            }
+            else
+            {
+                return fail(*pos == '%' ?
+                    "parameter entities are not supported" :
+                    "unexpected content");
+            }
+        }
+    }
+
+    // Description of the last compilation error
+    const std::string& error() const
+    {
+        return m_error;
+    }
+
+    bool empty() const
+    {
+        return m_elements.empty();
+    }
+
+    void clear()
+    {
+        m_elements.clear();
+        m_ids.clear();
+        m_error.clear();
+    }
+
+    // Declared (or referenced) element of the name, or nullptr
+    const Element* find(const XmlSax::String& name) const
+    {
+        const uint32_t i = lookup(name);
+        return i == NoState ? nullptr : &m_elements[i];
+    }
+
+    // Next state of the parent's content model after the child element,
+    // or NoState if the child is not allowed there
+    uint32_t next(
+        const Element& parent,
+        uint32_t state,
+        const Element& child) const
+    {
+        const uint32_t childId = static_cast<uint32_t>(&child - &m_elements[0]);
+        const auto it = std::lower_bound(
+            parent.symbols.begin(), parent.symbols.end(), childId);
+        if (it == parent.symbols.end() || *it != childId)
+            return NoState;
+        return parent.transitions[
+            state * parent.symbols.size() + (it - parent.symbols.begin())];
+    }
+
+private: // types
+    // Content model syntax tree
+    struct Node
+    {
+        // 'n': name, ',': sequence, '|': choice
+        char kind;
+        uint32_t symbol;
+        // 0, '?', '*', '+'
+        char repeat;
+        std::vector<Node> children;
+    };
+
+    // Glushkov automaton construction data
+    struct Positions
+    {
+        std::vector<uint32_t> symbols;
+        std::vector<std::vector<uint32_t> > follow;
+    };
+
+    struct Sets
+    {
+        bool nullable;
+        std::vector<uint32_t> first;
+        std::vector<uint32_t> last;
+    };
+
+private: // functions
+    bool fail(const char* info)
+    {
+        m_error = info;
+        return false;
+    }
+
+    uint32_t lookup(const XmlSax::String& name) const
+    {
+        const auto range = m_ids.equal_range(XmlSax::hash(name));
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (xmlsaxpipeline::equal(name, m_elements[it->second].name))
+                return it->second;
+        }
+        return NoState;
+    }
+
+    // Id of the element; added if not known yet
+    uint32_t id(const std::string& name)
+    {
+        const XmlSax::String s(name.data(), name.data() + name.size());
+        uint32_t i = lookup(s);
+        if (i == NoState)
+        {
+            i = static_cast<uint32_t>(m_elements.size());
+            Element e;
+            e.name = name;
+            e.declared = false;
+            e.type = Any;
+            e.anyAttributes = false;
+            m_elements.push_back(e);
+            m_ids.insert(std::make_pair(XmlSax::hash(s), i));
+        }
+        return i;
+    }
+
+    bool declare(const std::string& name, const char* pos, const char* end)
+    {
+        Node root;
+        ContentType type = Children;
+        if (!parseModel(pos, end, root, type))
+            return false;
+
+        const uint32_t i = id(name);
+        if (m_elements[i].declared)
+            return fail("element declared twice");
+
+        Element& e = m_elements[i];
+        e.declared = true;
+        e.type = type;
+        if (type == Mixed || type == Children)
+            compile(root, e);
+        return true;
+    }
+
+    // contentspec ::= 'EMPTY' | 'ANY' | Mixed | children
+    bool parseModel(const char* pos, const char* end, Node& root, ContentType& type)
+    {
+        pos = skipSpaces(pos, end);
+        if (startsWord(pos, end, "EMPTY") || startsWord(pos, end, "ANY"))
+        {
+            type = *pos == 'E' ? Empty : Any;
+            pos += type == Empty ? 5 : 3;
+        }
+        else if (pos != end && *pos == '(')
+        {
+            pos = skipSpaces(pos + 1, end);
+            if (startsWith(pos, end, "#PCDATA"))
+            {
+                // Mixed ::= '(' '#PCDATA' ('|' Name)* ')*' | '(' '#PCDATA' ')'
+                type = Mixed;
+                root.kind = '|';
+                root.repeat = '*';
+                pos += 7;
+                for (;;)
+                {
+                    pos = skipSpaces(pos, end);
+                    if (pos == end || *pos != '|')
+                        break;
+                    pos = skipSpaces(pos + 1, end);
+                    Node leaf;
+                    if (!parseLeaf(pos, end, leaf))
+                        return false;
+                    root.children.push_back(leaf);
+                }
+                if (pos == end || *pos != ')')
+                    return fail("')' expected in mixed content model");
+                ++pos;
+                if (pos != end && *pos == '*')
+                    ++pos;
+                else if (!root.children.empty())
+                    return fail("')*' expected in mixed content model");
+            }
+            else
+            {
+                type = Children;
+                if (!parseGroup(pos, end, root))
+                    return false;
+            }
+        }
+        else
+        {
+            return fail("content model expected");
+        }
+
+        if (skipSpaces(pos, end) != end)
+            return fail("unexpected content after content model");
+        return true;
+    }
+
+    // cp ::= (Name | choice | seq) ('?' | '*' | '+')?
+    bool parseParticle(const char*& pos, const char* end, Node& node)
+    {
+        pos = skipSpaces(pos, end);
+        if (pos != end && *pos == '(')
+        {
+            pos = skipSpaces(pos + 1, end);
+            return parseGroup(pos, end, node);
+        }
+        if (!parseLeaf(pos, end, node))
+            return false;
+        parseRepeat(pos, end, node);
+        return true;
+    }
+
+    // Group after '(': cp ((',' cp)* | ('|' cp)*) ')' with optional repeat
+    bool parseGroup(const char*& pos, const char* end, Node& node)
+    {
+        node.kind = ',';
+        node.repeat = 0;
+        char separator = 0;
+        for (;;)
+        {
+            node.children.push_back(Node());
+            if (!parseParticle(pos, end, node.children.back()))
+                return false;
+
+            pos = skipSpaces(pos, end);
+            if (pos == end)
+                return fail("')' expected in content model");
+            if (*pos == ')')
+                break;
+            if ((*pos != ',' && *pos != '|') || (separator && *pos != separator))
+                return fail("',' or '|' expected in content model");
+            separator = *pos++;
+        }
+        ++pos;
+        if (separator == '|')
+            node.kind = '|';
+        parseRepeat(pos, end, node);
+        return true;
+    }
+
+    bool parseLeaf(const char*& pos, const char* end, Node& node)
+    {
+        std::string name;
+        if (!parseName(pos, end, name))
+            return false;
+        node.kind = 'n';
+        node.symbol = id(name);
+        node.repeat = 0;
+        return true;
+    }
+
+    static void parseRepeat(const char*& pos, const char* end, Node& node)
+    {
+        if (pos != end && (*pos == '?' || *pos == '*' || *pos == '+'))
+            node.repeat = *pos++;
+    }
+
+    bool parseName(const char*& pos, const char* end, std::string& name)
+    {
+        const char* const begin = pos;
+        while (pos != end && !isspace(static_cast<unsigned char>(*pos)) &&
+            !strchr("()|,?*+>\"'", *pos))
+            ++pos;
+        if (pos == begin)
+            return fail("name expected");
+        name.assign(begin, pos);
+        return true;
+    }
+
+    // AttlistDecl ::= '<!ATTLIST' S Name AttDef* S? '>', after '<!ATTLIST'
+    bool attributeList(const char*& pos, const char* end)
+    {
+        std::string element;
+        pos = skipSpaces(pos, end);
+        if (!parseName(pos, end, element))
+            return false;
+
+        for (;;)
+        {
+            pos = skipSpaces(pos, end);
+            if (pos == end)
+                return fail("unterminated <!ATTLIST>");
+            if (*pos == '>')
+            {
+                ++pos;
+                return true;
+            }
+
+            // AttDef ::= S Name S AttType S DefaultDecl
+            std::string name;
+            std::string type;
+            if (!parseName(pos, end, name))
+                return false;
+            pos = skipSpaces(pos, end);
+            if (pos != end && *pos != '(')
+            {
+                if (!parseName(pos, end, type))
+                    return false;
+                pos = skipSpaces(pos, end);
+            }
+            if (pos != end && *pos == '(')
+            {
+                // Enumeration, or NOTATION
+                pos = skipQuoted(pos, end, ')');
+                if (pos == end)
+                    return fail("')' expected in attribute type");
+                pos = skipSpaces(pos + 1, end);
+            }
+            else if (type.empty())
+            {
+                return fail("attribute type expected");
+            }
+
+            bool required = false;
+            if (startsWith(pos, end, "#REQUIRED") || startsWith(pos, end, "#IMPLIED"))
+            {
+                required = pos[1] == 'R';
+                pos += required ? 9 : 8;
+            }
+            else
+            {
+                if (startsWith(pos, end, "#FIXED"))
+                    pos = skipSpaces(pos + 6, end);
+                if (pos == end || (*pos != '"' && *pos != '\''))
+                    return fail("attribute default value expected");
+                const char* const close =
+                    static_cast<const char*>(memchr(pos + 1, *pos, static_cast<size_t>(end - pos - 1)));
+                if (!close)
+                    return fail("unterminated attribute default value");
+                pos = close + 1;
+            }
+
+            attribute(element, name, required);
+        }
+    }
+
+    // Build the DFA of the content model
+    void compile(const Node& root, Element& e) const
+    {
+        Positions positions;
+        const Sets sets = build(root, positions);
+
+        e.symbols = positions.symbols;
+        std::sort(e.symbols.begin(), e.symbols.end());
+        e.symbols.erase(std::unique(e.symbols.begin(), e.symbols.end()),
+            e.symbols.end());
+
+        // Subset construction; the initial state is the empty set
+        std::vector<std::vector<uint32_t> > states(1);
+        std::map<std::vector<uint32_t>, uint32_t> stateIds;
+        stateIds[states[0]] = 0;
+
+        for (size_t s = 0; s < states.size(); ++s)
+        {
+            e.accepting.push_back(s ?
+                intersects(states[s], sets.last) : sets.nullable);
+
+            for (auto symbol : e.symbols)
+            {
+                // Positions of the symbol which may follow the state's ones
+                std::vector<uint32_t> target;
+                if (!s)
+                {
+                    for (auto q : sets.first)
+                    {
+                        if (positions.symbols[q] == symbol)
+                            target.push_back(q);
+                    }
+                }
+                else
+                {
+                    for (auto p : states[s])
+                    {
+                        for (auto q : positions.follow[p])
+                        {
+                            if (positions.symbols[q] == symbol)
+                                target.push_back(q);
+                        }
+                    }
+                    std::sort(target.begin(), target.end());
+                    target.erase(std::unique(target.begin(), target.end()),
+                        target.end());
+                }
+
+                if (target.empty())
+                {
+                    e.transitions.push_back(NoState);
+                    continue;
+                }
+                const auto it = stateIds.insert(std::make_pair(
+                    target, static_cast<uint32_t>(states.size())));
+                if (it.second)
+                    states.push_back(target);
+                e.transitions.push_back(it.first->second);
+            }
+        }
+    }
+
+    static Sets build(const Node& node, Positions& positions)
+    {
+        Sets sets;
+        if (node.kind == 'n')
+        {
+            const uint32_t p = static_cast<uint32_t>(positions.symbols.size());
+            positions.symbols.push_back(node.symbol);
+            positions.follow.push_back(std::vector<uint32_t>());
+            sets.nullable = false;
+            sets.first.push_back(p);
+            sets.last.push_back(p);
+        }
+        else if (node.kind == '|')
+        {
+            // Empty choice: mixed content of text only
+            sets.nullable = node.children.empty();
+            for (const auto& child : node.children)
+            {
+                const Sets c = build(child, positions);
+                sets.nullable = sets.nullable || c.nullable;
+                merge(sets.first, c.first);
+                merge(sets.last, c.last);
+            }
+        }
+        else
+        {
+            sets.nullable = true;
+            for (const auto& child : node.children)
+            {
+                const Sets c = build(child, positions);
+                for (auto p : sets.last)
+                    merge(positions.follow[p], c.first);
+                if (sets.nullable)
+                    merge(sets.first, c.first);
+                if (!c.nullable)
+                    sets.last.clear();
+                merge(sets.last, c.last);
+                sets.nullable = sets.nullable && c.nullable;
+            }
+        }
+
+        if (node.repeat == '*' || node.repeat == '+')
+        {
+            for (auto p : sets.last)
+                merge(positions.follow[p], sets.first);
+        }
+        if (node.repeat == '*' || node.repeat == '?')
+            sets.nullable = true;
+        return sets;
+    }
+
+    // Sorted sets union
+    static void merge(std::vector<uint32_t>& to, const std::vector<uint32_t>& from)
+    {
+        std::vector<uint32_t> result;
+        std::set_union(to.begin(), to.end(), from.begin(), from.end(),
+            std::back_inserter(result));
+        to.swap(result);
+    }
+
+    static bool intersects(
+        const std::vector<uint32_t>& s1,
+        const std::vector<uint32_t>& s2)
+    {
+        for (auto p : s1)
+        {
+            if (std::binary_search(s2.begin(), s2.end(), p))
+                return true;
+        }
+        return false;
+    }
+
+    static const char* skipSpaces(const char* pos, const char* end)
+    {
+        while (pos != end && isspace(static_cast<unsigned char>(*pos)))
+            ++pos;
+        return pos;
+    }
+
+    // Position of the character outside of quoted strings, or end
+    static const char* skipQuoted(const char* pos, const char* end, char c)
+    {
+        for (char quote = 0; pos != end; ++pos)
+        {
+            if (quote)
+            {
+                if (*pos == quote)
+                    quote = 0;
+            }
+            else if (*pos == '"' || *pos == '\'')
+            {
+                quote = *pos;
+            }
+            else if (*pos == c)
+            {
+                break;
+            }
+        }
+        return pos;
+    }
+
+    static bool startsWith(const char* pos, const char* end, const char* s)
+    {
+        const size_t length = strlen(s);
+        return static_cast<size_t>(end - pos) >= length && !strncmp(pos, s, length);
+    }
+
+    static bool startsWord(const char* pos, const char* end, const char* s)
+    {
+        const char* const next = pos + strlen(s);
+        return startsWith(pos, end, s) &&
+            (next == end || isspace(static_cast<unsigned char>(*next)));
+    }
+
+    static const char* find(const char* pos, const char* end, const char* s)
+    {
+        for (; pos != end; ++pos)
+        {
+            if (startsWith(pos, end, s))
+                return pos;
+        }
+        return nullptr;
+    }
+
+private: // data
+    std::vector<Element> m_elements;
+    // Element name hash -> index of m_elements
+    std::unordered_multimap<uint64_t, uint32_t> m_ids;
+    std::string m_error;
+};
+
+/// Validates the events against the schema, and forwards them
+class XmlSaxValidator : public XmlSaxFilter
+{
+public: // constructors
+    // Validate against the document's DTD internal subset
+    XmlSaxValidator(XmlSax::Visitor& next):
+        XmlSaxFilter(next),
+        m_schema(&m_dtd),
+        m_startTag(false),
+        m_startTagPos(nullptr)
+    {}
+
+    // Validate against schema; the document's DTD is ignored
+    XmlSaxValidator(XmlSax::Visitor& next, const XmlSaxSchema& schema):
+        XmlSaxFilter(next),
+        m_schema(&schema),
+        m_startTag(false),
+        m_startTagPos(nullptr)
+    {}
+
+public: // function members
+    virtual bool doctype(const XmlSax::String& declarations)
+    {
+        if (m_schema == &m_dtd)
+        {
+            m_dtd.clear();
+            if (!m_dtd.dtd(declarations))
+            {
+                return fail(("ERROR: invalid DTD: " + m_dtd.error()).c_str(),
+                    declarations.first);
+            }
+        }
+        return m_next.doctype(declarations);
+    }
+    virtual bool enter(const XmlSax::String& element, bool isEmptyElementTag)
+    {
+        if (m_schema->empty())
+            return m_next.enter(element, isEmptyElementTag);
+        if (!checkStartTag())
+            return false;
+
+        const XmlSaxSchema::Element* const e = m_schema->find(element);
+        if (!e || !e->declared)
+            return fail("ERROR: element not declared", element.first);
+
+        if (!m_stack.empty())
+        {
+            Frame& parent = m_stack.back();
+            if (parent.element->type == XmlSaxSchema::Empty ||
+                (parent.element->type != XmlSaxSchema::Any &&
+                    (parent.state = m_schema->next(*parent.element,
+                        parent.state, *e)) == XmlSaxSchema::NoState))
+            {
+                return fail(("ERROR: element not allowed in \"" +
+                    parent.element->name + "\"").c_str(), element.first);
+            }
+        }
+
+        const Frame frame = { e, 0 };
+        m_stack.push_back(frame);
+        m_seen.assign(e->attributes.size(), 0);
+        m_startTag = true;
+        m_startTagPos = element.first;
+        return m_next.enter(element, isEmptyElementTag);
+    }
+    virtual bool exit(const XmlSax::String& element, bool isEmptyElementTag)
+    {
+        if (m_stack.empty())
+            return m_next.exit(element, isEmptyElementTag);
+        if (!checkStartTag())
+            return false;
+
+        const Frame& frame = m_stack.back();
+        if (frame.element->type >= XmlSaxSchema::Mixed &&
+            !frame.element->accepting[frame.state])
+        {
+            return fail(("ERROR: incomplete content of \"" +
+                frame.element->name + "\"").c_str(), element.first);
+        }
+        m_stack.pop_back();
+        return m_next.exit(element, isEmptyElementTag);
+    }
+    virtual bool attribute(
+        const XmlSax::String& name,
+        const XmlSax::String& value)
+    {
+        if (!m_stack.empty() && !m_stack.back().element->anyAttributes)
+        {
+            const auto& attributes = m_stack.back().element->attributes;
+            size_t n = 0;
+            while (n < attributes.size() &&
+                !xmlsaxpipeline::equal(name, attributes[n].name))
+                ++n;
+            if (n == attributes.size())
+                return fail("ERROR: attribute not declared", name.first);
+            m_seen[n] = 1;
+        }
+        return m_next.attribute(name, value);
+    }
+    virtual bool text(const XmlSax::String& content)
+    {
+        const char* pos = content.first;
+        while (pos != content.second && isspace(static_cast<unsigned char>(*pos)))
+            ++pos;
+        return checkContent(pos != content.second, content.first) &&
+            m_next.text(content);
+    }
+    virtual bool cdata(const XmlSax::String& content)
+    {
+        return checkContent(true, content.first) && m_next.cdata(content);
+    }
+    virtual bool fragment(const XmlSax::String& fragment)
+    {
+        m_stack.clear();
+        return m_next.fragment(fragment);
+    }
+
+private: // types
+    struct Frame
+    {
+        const XmlSaxSchema::Element* element;
+        // State of the element's content model DFA
+        uint32_t state;
+    };
+
+private: // functions
+    bool fail(const char* info, const char* docPos)
+    {
+        m_next.error(info, docPos);
+        return false;
+    }
+
+    // Required attributes are checked when the start tag is complete
+    bool checkStartTag()
+    {
+        if (!m_startTag)
+            return true;
+        m_startTag = false;
+
+        const auto& attributes = m_stack.back().element->attributes;
+        for (size_t n = 0; n < attributes.size(); ++n)
+        {
+            if (attributes[n].required && !m_seen[n])
+            {
+                return fail(("ERROR: required attribute missing: \"" +
+                    attributes[n].name + "\"").c_str(), m_startTagPos);
+            }
+        }
+        return true;
+    }
+
+    // Character data is allowed in mixed and any content only
+    bool checkContent(bool isCharacterData, const char* docPos)
+    {
+        if (m_stack.empty())
+            return true;
+        if (!checkStartTag())
+            return false;
+
+        const XmlSaxSchema::ContentType type = m_stack.back().element->type;
+        if (isCharacterData &&
+            (type == XmlSaxSchema::Empty || type == XmlSaxSchema::Children))
+        {
+            return fail(("ERROR: character data not allowed in \"" +
+                m_stack.back().element->name + "\"").c_str(), docPos);
+        }
+        return true;
+    }
+
+private: // data
+    XmlSaxSchema m_dtd;
+    const XmlSaxSchema* m_schema;
+    std::vector<Frame> m_stack;
+    // Attributes of the current start tag seen so far
+    std::vector<char> m_seen;
+    bool m_startTag;
+    const char* m_startTagPos;
+};
+} // headeronly
+
+#endif // HO_SAX_SCHEMA_HPP_
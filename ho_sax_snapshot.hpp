@@ -0,0 +1,325 @@
+/*
+MIT License
+
+Copyright (c) 2016 Maciej Kalinski https://github.com/rumcays
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+    @file  ho_sax_snapshot.hpp
+
+    @description
+    This is a part of header-only (see: wiki Header-only) tiny utils library.
+
+    Binary snapshot of the XmlSax event stream.
+    A successful parse may be recorded into a compact binary blob, keyed
+    by the length and the hash of the input document. Later the blob may be replayed
+    straight into the visitor's callbacks without tokenizing the document
+    again; if the blob does not match the document (or it is damaged),
+    the document is parsed as usual.
+    Content passed to the callbacks during replay points into the blob,
+    so the auxiliary conversion methods (XmlSax::toString*) work as
+    for the parsed document. Error positions cannot be replayed, that's
+    why only successful parses are recorded. Neither are the doctype()
+    callback (a validating visitor should be given its schema directly),
+    and span() (it's passed while the snapshot is created only).
+
+    The blob is meant to be a local cache: integers are stored in
+    the native byte order. Reading and writing the blob (e.g. memory
+    mapping the file) is up to the client.
+
+    Usage:
+        std::string blob;
+        XmlSaxSnapshot::create(doc, visitor, blob); // store the blob
+        ...
+        XmlSaxSnapshot::replay(blob.data(), blob.size(), doc, visitor);
+*/
+
+#ifndef HO_SAX_SNAPSHOT_HPP_
+#define HO_SAX_SNAPSHOT_HPP_
+
+#include "ho_sax.hpp"
+
+namespace headeronly
+{
+class XmlSaxSnapshot
+{
+public: // function members
+    // Parse doc forwarding events to visitor, and record them to snapshot.
+    // Return false if parsing failed; snapshot is left empty in such case.
+    static bool create(
+        const char* doc,
+        XmlSax::Visitor& visitor,
+        std::string& snapshot)
+    {
+        assert(doc);
+
+        const XmlSax::String document(doc, doc + strlen(doc));
+        snapshot.clear();
+        put(snapshot, static_cast<uint32_t>(Magic));
+        put(snapshot, static_cast<uint32_t>(Version));
+        put(snapshot, static_cast<uint64_t>(document.second - document.first));
+        put(snapshot, XmlSax::hash(document));
+
+        Recorder recorder(visitor, snapshot);
+        if (!XmlSax(recorder).parse(doc))
+        {
+            snapshot.clear();
+            return false;
+        }
+
+        snapshot.push_back(End);
+        return true;
+    }
+
+    // Check whether snapshot has been created from doc
+    static bool matches(
+        const char* snapshot,
+        size_t size,
+        const char* doc)
+    {
+        assert(snapshot && doc);
+
+        const char* pos = snapshot;
+        const char* const end = snapshot + size;
+        uint32_t magic = 0;
+        uint32_t version = 0;
+        uint64_t docLength = 0;
+        uint64_t docHash = 0;
+        const XmlSax::String document(doc, doc + strlen(doc));
+
+        // The length is checked first: it's cheap, and it makes a stale
+        // snapshot with a colliding hash less likely to match
+        return get(pos, end, magic) && magic == Magic &&
+            get(pos, end, version) && version == Version &&
+            get(pos, end, docLength) &&
+            docLength == static_cast<uint64_t>(document.second - document.first) &&
+            get(pos, end, docHash) && docHash == XmlSax::hash(document) &&
+            walk(pos, end, nullptr);
+    }
+
+    // Replay snapshot events to visitor if snapshot matches doc;
+    // otherwise parse doc.
+    // Return false if parsing failed, or a callback function returned false.
+    static bool replay(
+        const char* snapshot,
+        size_t size,
+        const char* doc,
+        XmlSax::Visitor& visitor)
+    {
+        if (!matches(snapshot, size, doc))
+            return XmlSax(visitor).parse(doc);
+
+        const char* pos = snapshot + HeaderSize;
+        return walk(pos, snapshot + size, &visitor);
+    }
+
+private: // types
+    enum
+    {
+        Magic = 0x58534f48, // "HOSX"
+        Version = 2,
+        HeaderSize = 2 * sizeof(uint32_t) + 2 * sizeof(uint64_t)
+    };
+
+    enum Event
+    {
+        End = 'Z',
+        Enter = 'E',
+        EnterEmpty = 'e',
+        Exit = 'X',
+        ExitEmpty = 'x',
+        Attribute = 'A',
+        Text = 'T',
+        Cdata = 'C'
+    };
+
+    struct Recorder : XmlSax::Visitor
+    {
+        Recorder(XmlSax::Visitor& visitor, std::string& snapshot):
+            m_visitor(visitor),
+            m_snapshot(snapshot)
+        {}
+
+        virtual bool enter(
+            const XmlSax::String& element,
+            bool isEmptyElementTag)
+        {
+            record(isEmptyElementTag ? EnterEmpty : Enter, element);
+            return m_visitor.enter(element, isEmptyElementTag);
+        }
+        virtual bool exit(
+            const XmlSax::String& element,
+            bool isEmptyElementTag)
+        {
+            record(isEmptyElementTag ? ExitEmpty : Exit, element);
+            return m_visitor.exit(element, isEmptyElementTag);
+        }
+        virtual bool attribute(
+            const XmlSax::String& name,
+            const XmlSax::String& value)
+        {
+            record(Attribute, name);
+            putString(m_snapshot, value);
+            return m_visitor.attribute(name, value);
+        }
+        virtual bool text(const XmlSax::String& content)
+        {
+            record(Text, content);
+            return m_visitor.text(content);
+        }
+        virtual bool cdata(const XmlSax::String& content)
+        {
+            record(Cdata, content);
+            return m_visitor.cdata(content);
+        }
+        virtual bool doctype(const XmlSax::String& declarations)
+        {
+            return m_visitor.doctype(declarations);
+        }
+        virtual bool span(
+            const XmlSax::String& element,
+            const XmlSax::String& outer,
+            const XmlSax::String& inner)
+        {
+            return m_visitor.span(element, outer, inner);
+        }
+        virtual void error(const char* info, const char* docPos)
+        {
+            m_visitor.error(info, docPos);
+        }
+        virtual bool validate()
+        {
+            return m_visitor.validate();
+        }
+        virtual bool utf8()
+        {
+            return m_visitor.utf8();
+        }
+        virtual bool spans()
+        {
+            return m_visitor.spans();
+        }
+
+        void record(Event event, const XmlSax::String& s)
+        {
+            m_snapshot.push_back(static_cast<char>(event));
+            putString(m_snapshot, s);
+        }
+
+        XmlSax::Visitor& m_visitor;
+        std::string& m_snapshot;
+    };
+
+private: // functions
+    template <typename T>
+    static void put(std::string& snapshot, T value)
+    {
+        snapshot.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    static void putString(std::string& snapshot, const XmlSax::String& s)
+    {
+        assert(s.first <= s.second);
+        put(snapshot, static_cast<uint32_t>(s.second - s.first));
+        snapshot.append(s.first, s.second);
+    }
+
+    template <typename T>
+    static bool get(const char*& pos, const char* end, T& value)
+    {
+        if (static_cast<size_t>(end - pos) < sizeof(value))
+            return false;
+        memcpy(&value, pos, sizeof(value));
+        pos += sizeof(value);
+        return true;
+    }
+
+    static bool getString(
+        const char*& pos,
+        const char* end,
+        XmlSax::String& s)
+    {
+        uint32_t length = 0;
+        if (!get(pos, end, length) ||
+            static_cast<size_t>(end - pos) < length)
+            return false;
+        s = XmlSax::String(pos, pos + length);
+        pos += length;
+        return true;
+    }
+
+    // Walk through the events; with no visitor only check the snapshot
+    // consistency (so the visitor never gets a partial stream from
+    // a damaged snapshot).
+    static bool walk(
+        const char*& pos,
+        const char* end,
+        XmlSax::Visitor* visitor)
+    {
+        XmlSax::String s1;
+        XmlSax::String s2;
+        size_t depth = 0;
+        bool retCode = true;
+
+        while (retCode && pos != end)
+        {
+            const char event = *pos++;
+            switch (event)
+            {
+            case End:
+                return pos == end && depth == 0;
+            case Enter:
+            case EnterEmpty:
+                retCode = getString(pos, end, s1);
+                ++depth;
+                if (retCode && visitor)
+                    retCode = visitor->enter(s1, event == EnterEmpty);
+                break;
+            case Exit:
+            case ExitEmpty:
+                retCode = depth-- > 0 && getString(pos, end, s1);
+                if (retCode && visitor)
+                    retCode = visitor->exit(s1, event == ExitEmpty);
+                break;
+            case Attribute:
+                retCode = depth > 0 &&
+                    getString(pos, end, s1) && getString(pos, end, s2);
+                if (retCode && visitor)
+                    retCode = visitor->attribute(s1, s2);
+                break;
+            case Text:
+            case Cdata:
+                retCode = depth > 0 && getString(pos, end, s1);
+                if (retCode && visitor)
+                    retCode = event == Text ?
+                        visitor->text(s1) : visitor->cdata(s1);
+                break;
+            default:
+                retCode = false;
+            }
+        }
+
+        return false;
+    }
+};
+} // headeronly
+
+#endif // HO_SAX_SNAPSHOT_HPP_
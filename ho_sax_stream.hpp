@@ -0,0 +1,800 @@
+/*
+MIT License
+
+Copyright (c) 2016 Maciej Kalinski https://github.com/rumcays
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+    @file  ho_sax_stream.hpp
+
+    @description
+    This is a part of header-only (see: wiki Header-only) tiny utils library.
+
+    Parsing input read in blocks, e.g. decompressed on the fly.
+    The source fills fixed size blocks; these are appended to the parse
+    buffer, and every complete fragment (root element) is parsed as soon as
+    it's there (see XmlSax::parseFragments()). Only the incomplete fragment
+    is kept between the blocks.
+    A big root element (e.g. of a single document) is parsed in parts:
+    once its complete children take a block (and at least MinPartSize),
+    they are parsed as if the root was closed after them, and dropped
+    from the buffer; only the root's start tag is kept for the next part.
+    So memory usage is bounded by a few blocks and the biggest child
+    of a root element, whatever the size of the input. The visitor gets
+    the same events as for the whole fragment, but enter() and attribute()
+    of the root come with its first part only, exit() and fragment() with
+    the last one (fragment() is given the last part then), and span()
+    is not called for the root.
+    Each block is scanned once for the fragment ends (resuming where
+    the previous one ended), and the parser is called only when a fragment
+    or a part is complete, so big fragments spanning many blocks aren't
+    rescanned for each of them.
+    Optionally, the source is read ahead by a separate thread, so reading
+    (and decompression) overlaps with parsing.
+
+    Sources:
+    * fileSource() - C file
+    * gzipSource() - gzip compressed file (or plain one), with zlib; needs
+      HO_SAX_ZLIB macro defined before including the file, and linking zlib
+    * zstdSource() - zstd compressed file; needs HO_SAX_ZSTD macro defined
+      and linking libzstd; a truncated last frame is a read failure
+    * custom ones - any function filling the blocks; an exception thrown
+      by the source is a read failure
+
+    Usage:
+        FILE* file = fopen("log.xml.zst", "rb");
+        XmlSaxStream stream(visitor);
+        stream.parse(XmlSaxStream::zstdSource(file));
+*/
+
+#ifndef HO_SAX_STREAM_HPP_
+#define HO_SAX_STREAM_HPP_
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "ho_sax.hpp"
+
+#ifdef HO_SAX_ZLIB
+#include <zlib.h>
+#endif // HO_SAX_ZLIB
+
+#ifdef HO_SAX_ZSTD
+#include <zstd.h>
+#endif // HO_SAX_ZSTD
+
+namespace headeronly
+{
+class XmlSaxStream
+{
+public: // types
+    /// Block source: store up to capacity bytes in buffer, and set size
+    /// to their number; size 0 means the end of input.
+    /// Return false if reading failed.
+    typedef std::function<bool(char* buffer, size_t capacity, size_t& size)>
+        Source;
+
+    enum
+    {
+        /// Minimal size of the children of a root element parsed as a part
+        MinPartSize = 64 * 1024
+    };
+
+public: // constructors
+    XmlSaxStream(
+        XmlSax::Visitor& visitor,
+        size_t blockSize = 256 * 1024,
+        bool readAhead = true):
+        m_visitor(visitor),
+        m_blockSize(blockSize),
+        m_readAhead(readAhead),
+        m_parts(visitor),
+        m_continued(0),
+        m_discard(false)
+    {
+        assert(m_blockSize > 0);
+    }
+
+public: // function members
+    // Parse the fragments (or a document) read from source;
+    // for recover see XmlSax::parseFragments(); the recovery from an error
+    // in a part of a root element skips the rest of that element.
+    // Return false if reading or parsing failed, or a callback function
+    // returned false.
+    bool parse(const Source& source, bool recover = false)
+    {
+        Reader reader(source, m_blockSize, m_readAhead);
+        XmlSax sax(m_parts);
+        bool retCode = true;
+
+        for (std::string block;;)
+        {
+            if (!reader.next(block))
+            {
+                m_visitor.error("ERROR: input read failure",
+                    m_buffer.c_str() + m_buffer.size());
+                clear();
+                return false;
+            }
+
+            const bool end = block.empty();
+            m_buffer += block;
+            if (!end && !m_scanner.scan(m_buffer))
+            {
+                if (!parsePart(sax, recover, retCode))
+                {
+                    clear();
+                    return false;
+                }
+                continue;
+            }
+
+            if (m_discard)
+                discardRoot();
+
+            // The last chunk has to be complete
+            const char* const data = m_buffer.c_str();
+            m_parts.mute(XmlSax::String(data, data + m_continued),
+                m_continued ? data + 1 : nullptr, nullptr);
+            const char* remainder = nullptr;
+            const bool parsed = sax.parseFragments(
+                data, recover, end ? nullptr : &remainder);
+            m_parts.mute(XmlSax::String(), nullptr, nullptr);
+            retCode = parsed && retCode;
+
+            if (end || !remainder)
+                break;
+
+            const size_t parsedSize = static_cast<size_t>(remainder - data);
+            m_buffer.erase(0, parsedSize);
+            m_scanner.erase(0, parsedSize);
+            m_continued = 0;
+        }
+
+        clear();
+        return retCode;
+    }
+
+    // Size of the input kept in the buffer, e.g. to check memory usage
+    // from a visitor's callback
+    size_t buffered() const
+    {
+        return m_buffer.size();
+    }
+
+    // Source reading a C file
+    static Source fileSource(FILE* file)
+    {
+        assert(file);
+        return [file](char* buffer, size_t capacity, size_t& size)
+        {
+            size = fread(buffer, 1, capacity, file);
+            return !ferror(file);
+        };
+    }
+
+#ifdef HO_SAX_ZLIB
+    // Source reading a gzip compressed (or plain) file
+    static Source gzipSource(gzFile file)
+    {
+        assert(file);
+        return [file](char* buffer, size_t capacity, size_t& size)
+        {
+            const int read = gzread(file, buffer, static_cast<unsigned>(
+                std::min<size_t>(capacity, 1u << 30)));
+            size = read > 0 ? static_cast<size_t>(read) : 0;
+            return read >= 0;
+        };
+    }
+#endif // HO_SAX_ZLIB
+
+#ifdef HO_SAX_ZSTD
+    // Source reading a zstd compressed file
+    static Source zstdSource(FILE* file)
+    {
+        assert(file);
+
+        struct State
+        {
+            State():
+                stream(ZSTD_createDStream()),
+                input(ZSTD_DStreamInSize()),
+                eof(false),
+                hint(1)
+            {
+                ZSTD_initDStream(stream);
+                in.src = input.data();
+                in.size = 0;
+                in.pos = 0;
+            }
+            ~State()
+            {
+                ZSTD_freeDStream(stream);
+            }
+
+            ZSTD_DStream* stream;
+            std::vector<char> input;
+            ZSTD_inBuffer in;
+            // The whole file was read
+            bool eof;
+            // Returned by the last decoder call which made progress;
+            // 0 if a frame was completed
+            size_t hint;
+        };
+        const std::shared_ptr<State> state = std::make_shared<State>();
+
+        return [file, state](char* buffer, size_t capacity, size_t& size)
+        {
+            ZSTD_outBuffer out = { buffer, capacity, 0 };
+            while (!out.pos)
+            {
+                if (state->in.pos == state->in.size && !state->eof)
+                {
+                    state->in.size = fread(
+                        state->input.data(), 1, state->input.size(), file);
+                    state->in.pos = 0;
+                    if (ferror(file))
+                        return false;
+                    state->eof = !state->in.size;
+                }
+
+                // At the end of file the decoder may still hold output;
+                // it's drained when a call gives none, and then the last
+                // frame has to be complete
+                const size_t inPos = state->in.pos;
+                const size_t hint = ZSTD_decompressStream(
+                    state->stream, &out, &state->in);
+                if (ZSTD_isError(hint))
+                    return false;
+                if (out.pos || state->in.pos != inPos)
+                    state->hint = hint;
+                if (state->eof && state->in.pos == state->in.size && !out.pos)
+                {
+                    size = 0;
+                    return !state->hint;
+                }
+            }
+            size = out.pos;
+            return true;
+        };
+    }
+#endif // HO_SAX_ZSTD
+
+private: // types
+    // Reads the blocks, optionally ahead in a separate thread
+    class Reader
+    {
+    public:
+        Reader(const Source& source, size_t blockSize, bool readAhead):
+            m_source(source),
+            m_blockSize(blockSize),
+            m_stopped(false)
+        {
+            if (readAhead)
+                m_thread = std::thread(&Reader::run, this);
+        }
+
+        ~Reader()
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopped = true;
+            }
+            m_cv.notify_all();
+            if (m_thread.joinable())
+                m_thread.join();
+        }
+
+        // Return false if reading failed; block is empty at the end of input
+        bool next(std::string& block)
+        {
+            if (!m_thread.joinable())
+                return read(block);
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this]{ return !m_queue.empty(); });
+            block.swap(m_queue.front().first);
+            const bool ok = m_queue.front().second;
+            m_queue.pop_front();
+            m_cv.notify_all();
+            return ok;
+        }
+
+    private:
+        // An exception of the source (e.g. std::bad_alloc) is a failure,
+        // not to terminate the reading thread
+        bool read(std::string& block)
+        {
+            size_t size = 0;
+            bool ok = false;
+            try
+            {
+                block.resize(m_blockSize);
+                ok = m_source(&block[0], block.size(), size);
+            }
+            catch (...)
+            {
+                ok = false;
+            }
+            assert(!ok || size <= block.size());
+            block.resize(ok ? size : 0);
+            return ok;
+        }
+
+        // Reading thread: keeps up to two blocks ready
+        void run()
+        {
+            for (;;)
+            {
+                std::string block;
+                const bool ok = read(block);
+                const bool last = !ok || block.empty();
+
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this]{ return m_stopped || m_queue.size() < 2; });
+                if (m_stopped)
+                    return;
+                m_queue.push_back(std::make_pair(std::move(block), ok));
+                m_cv.notify_all();
+                if (last)
+                    return;
+            }
+        }
+
+        const Source& m_source;
+        size_t m_blockSize;
+
+        std::thread m_thread;
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        // Blocks read ahead, with reading status
+        std::deque<std::pair<std::string, bool> > m_queue;
+        bool m_stopped;
+    };
+
+    // Forwards the events to the visitor, but those of a root element
+    // parsed in parts which belong to another part (see parsePart())
+    class Parts : public XmlSax::Visitor
+    {
+    public:
+        Parts(XmlSax::Visitor& visitor):
+            m_visitor(visitor),
+            m_startTag(nullptr, nullptr),
+            m_root(nullptr),
+            m_endTag(nullptr),
+            m_errors(0)
+        {}
+
+        // startTag: the copy of the start tag of a root element continued
+        //   from the previous part; its enter() and attribute() are muted
+        // root: name of the root element parsed in parts; its span() is
+        //   muted
+        // endTag: the end tag closing a part, which isn't the last one;
+        //   its exit() and fragment() are muted
+        void mute(
+            const XmlSax::String& startTag,
+            const char* root,
+            const char* endTag)
+        {
+            m_startTag = startTag;
+            m_root = root;
+            m_endTag = endTag;
+            m_errors = 0;
+        }
+
+        // Number of errors reported since mute()
+        size_t errors() const
+        {
+            return m_errors;
+        }
+
+        virtual bool enter(const XmlSax::String& element, bool isEmptyElementTag)
+        {
+            return inStartTag(element) ||
+                m_visitor.enter(element, isEmptyElementTag);
+        }
+        virtual bool exit(const XmlSax::String& element, bool isEmptyElementTag)
+        {
+            return (m_endTag && element.first >= m_endTag) ||
+                m_visitor.exit(element, isEmptyElementTag);
+        }
+        virtual bool attribute(
+            const XmlSax::String& name,
+            const XmlSax::String& value)
+        {
+            return inStartTag(name) || m_visitor.attribute(name, value);
+        }
+        virtual bool text(const XmlSax::String& content)
+        {
+            return m_visitor.text(content);
+        }
+        virtual bool cdata(const XmlSax::String& content)
+        {
+            return m_visitor.cdata(content);
+        }
+        virtual bool doctype(const XmlSax::String& declarations)
+        {
+            return m_visitor.doctype(declarations);
+        }
+        virtual bool fragment(const XmlSax::String& fragment)
+        {
+            return m_endTag || m_visitor.fragment(fragment);
+        }
+        virtual bool span(
+            const XmlSax::String& element,
+            const XmlSax::String& outer,
+            const XmlSax::String& inner)
+        {
+            return element.first == m_root ||
+                m_visitor.span(element, outer, inner);
+        }
+        virtual void error(const char* info, const char* docPos)
+        {
+            ++m_errors;
+            m_visitor.error(info, docPos);
+        }
+        virtual bool validate()
+        {
+            return m_visitor.validate();
+        }
+        virtual bool utf8()
+        {
+            return m_visitor.utf8();
+        }
+        virtual bool spans()
+        {
+            return m_visitor.spans();
+        }
+
+    private:
+        bool inStartTag(const XmlSax::String& s) const
+        {
+            return s.first >= m_startTag.first && s.first < m_startTag.second;
+        }
+
+        XmlSax::Visitor& m_visitor;
+        XmlSax::String m_startTag;
+        const char* m_root;
+        const char* m_endTag;
+        size_t m_errors;
+    };
+
+    // Incremental scan for the fragment ends, by the rules of
+    // XmlSax::scanElementEnd(); a markup split between the blocks is
+    // resumed, not rescanned. It also tracks the children of the open
+    // root element, to parse them in parts.
+    class Scanner
+    {
+    public:
+        Scanner()
+        {
+            reset();
+        }
+
+        void reset()
+        {
+            m_pos = 0;
+            m_markup = std::string::npos;
+            m_kind = Unknown;
+            m_quote = 0;
+            m_depth = 0;
+            m_completed = std::string::npos;
+            m_root = std::string::npos;
+            m_rootEnd = std::string::npos;
+            m_childrenEnd = std::string::npos;
+        }
+
+        // Scan the data appended to buffer since the last call.
+        // Return true if a fragment is complete since the last erase().
+        bool scan(const std::string& buffer)
+        {
+            const char* const data = buffer.c_str();
+            const size_t size = buffer.size();
+
+            for (;;)
+            {
+                if (m_markup == std::string::npos)
+                {
+                    m_markup = buffer.find('<', m_pos);
+                    if (m_markup == std::string::npos)
+                    {
+                        m_pos = size;
+                        break;
+                    }
+                    m_kind = Unknown;
+                }
+
+                if (m_kind == Unknown)
+                {
+                    const char* const markup = data + m_markup;
+                    const size_t available = size - m_markup;
+                    if (available < 2 ||
+                        isPrefix(markup, available, "<!--") ||
+                        isPrefix(markup, available, "<![CDATA[") ||
+                        isPrefix(markup, available, "<!DOCTYPE"))
+                        break;
+
+                    if (!strncmp(markup, "<!--", 4))
+                        start(Comment, 4);
+                    else if (!strncmp(markup, "<![CDATA[", 9))
+                        start(Cdata, 9);
+                    else if (!strncmp(markup, "<!DOCTYPE", 9))
+                        start(Doctype, 9);
+                    else if (markup[1] == '!')
+                        start(Declaration, 2);
+                    else if (markup[1] == '?')
+                        start(Pi, 2);
+                    else
+                        start(Tag, 1);
+                }
+
+                if (m_kind == Doctype)
+                {
+                    // The internal subset contains '>'
+                    while (m_pos != size && data[m_pos] != '[' && data[m_pos] != '>')
+                        ++m_pos;
+                    if (m_pos == size)
+                        break;
+                    if (data[m_pos++] == '[')
+                    {
+                        m_kind = Subset;
+                        continue;
+                    }
+                }
+                else if (m_kind == Tag)
+                {
+                    while (m_pos != size && (m_quote || data[m_pos] != '>'))
+                    {
+                        if (m_quote)
+                            m_quote = data[m_pos] == m_quote ? 0 : m_quote;
+                        else if (data[m_pos] == '"' || data[m_pos] == '\'')
+                            m_quote = data[m_pos];
+                        ++m_pos;
+                    }
+                    if (m_pos == size)
+                        break;
+
+                    const bool isClosing = data[m_markup + 1] == '/';
+                    const bool isEmpty = !isClosing && data[m_pos - 1] == '/';
+                    if (isClosing)
+                        m_depth -= m_depth ? 1 : 0;
+                    else if (!isEmpty)
+                        ++m_depth;
+                    ++m_pos;
+
+                    if (!m_depth)
+                    {
+                        if (m_completed == std::string::npos)
+                            m_completed = m_pos;
+                        m_root = m_rootEnd = m_childrenEnd = std::string::npos;
+                    }
+                    else if (m_depth == 1 && !isClosing && !isEmpty)
+                    {
+                        m_root = m_markup;
+                        m_rootEnd = m_childrenEnd = m_pos;
+                    }
+                    else if (m_depth == 1)
+                    {
+                        m_childrenEnd = m_pos;
+                    }
+                }
+                else
+                {
+                    static const char* const terminators[] = {
+                        "", "-->", "]]>", "?>", "", "]>", ">", "" };
+                    const char* const terminator = terminators[m_kind];
+                    const size_t length = strlen(terminator);
+                    const size_t end = buffer.find(terminator, m_pos);
+                    if (end == std::string::npos)
+                    {
+                        // The terminator may be split
+                        m_pos = std::max(m_pos, size - std::min(size, length - 1));
+                        break;
+                    }
+                    m_pos = end + length;
+                }
+                m_markup = std::string::npos;
+            }
+            return m_completed != std::string::npos;
+        }
+
+        // [pos, pos + size) of the buffer was erased
+        void erase(size_t pos, size_t size)
+        {
+            const size_t scanned =
+                m_markup == std::string::npos ? m_pos : m_markup;
+            if (pos + size > scanned)
+            {
+                // Parsed beyond the scan (e.g. while recovering)
+                reset();
+                return;
+            }
+            shift(m_pos, pos, size);
+            shift(m_markup, pos, size);
+            shift(m_root, pos, size);
+            shift(m_rootEnd, pos, size);
+            shift(m_childrenEnd, pos, size);
+            m_completed = std::string::npos;
+        }
+
+        // End of the first fragment completed since the last erase(),
+        // or npos
+        size_t completed() const
+        {
+            return m_completed;
+        }
+
+        // Open root element: its start tag [root(), rootEnd()), followed by
+        // the complete children up to childrenEnd(); npos if there is none
+        size_t root() const
+        {
+            return m_root;
+        }
+        size_t rootEnd() const
+        {
+            return m_rootEnd;
+        }
+        size_t childrenEnd() const
+        {
+            return m_childrenEnd;
+        }
+
+    private:
+        enum Kind { Unknown, Comment, Cdata, Pi, Doctype, Subset, Declaration, Tag };
+
+        void start(Kind kind, size_t length)
+        {
+            m_kind = kind;
+            m_pos = m_markup + length;
+            m_quote = 0;
+        }
+
+        // Position after the erased [erased, erased + size)
+        static void shift(size_t& pos, size_t erased, size_t size)
+        {
+            if (pos == std::string::npos || pos <= erased)
+                return;
+            pos = pos >= erased + size ? pos - size : std::string::npos;
+        }
+
+        // Check if [s, s + size) is a proper prefix of what
+        static bool isPrefix(const char* s, size_t size, const char* what)
+        {
+            return size < strlen(what) && !strncmp(s, what, size);
+        }
+
+        // Position the scan resumes at
+        size_t m_pos;
+        // Start of the markup being scanned, or npos if none
+        size_t m_markup;
+        Kind m_kind;
+        // Open quote of an attribute value of the tag being scanned
+        char m_quote;
+        size_t m_depth;
+        size_t m_completed;
+        size_t m_root;
+        size_t m_rootEnd;
+        size_t m_childrenEnd;
+    };
+
+private: // functions
+    // Parse the complete children of the open root element, if they are
+    // big enough, as if the root was closed after them; then drop them
+    // from the buffer, keeping the root's start tag for the next part.
+    // After a part failed (in recover mode), the rest of the root element
+    // is dropped without parsing.
+    // Return false if parsing has been stopped (see parse()).
+    bool parsePart(XmlSax& sax, bool recover, bool& retCode)
+    {
+        const size_t root = m_scanner.root();
+        const size_t rootEnd = m_scanner.rootEnd();
+        const size_t childrenEnd = m_scanner.childrenEnd();
+        if (root == std::string::npos ||
+            childrenEnd - rootEnd < std::max<size_t>(m_blockSize, MinPartSize))
+            return true;
+
+        if (!m_discard)
+        {
+            // The rest of the buffer is put aside for the end tag
+            m_rest.assign(m_buffer, childrenEnd, std::string::npos);
+            m_buffer.resize(childrenEnd);
+            const size_t name = root + 1;
+            const size_t nameEnd = m_buffer.find_first_of(" \t\r\n/>", name);
+            m_buffer += "</";
+            m_buffer.append(m_buffer, name, nameEnd - name);
+            m_buffer += '>';
+
+            const char* const data = m_buffer.c_str();
+            m_parts.mute(XmlSax::String(data, data + m_continued),
+                data + name, data + childrenEnd);
+            const bool parsed = sax.parseFragments(data, recover);
+            const size_t errors = m_parts.errors();
+            m_parts.mute(XmlSax::String(), nullptr, nullptr);
+            if (!parsed && (!recover || !errors))
+                return false;
+            if (!parsed)
+            {
+                retCode = false;
+                m_discard = true;
+            }
+
+            m_buffer.resize(childrenEnd);
+            m_buffer += m_rest;
+        }
+
+        m_buffer.erase(rootEnd, childrenEnd - rootEnd);
+        m_scanner.erase(rootEnd, childrenEnd - rootEnd);
+        m_buffer.erase(0, root);
+        m_scanner.erase(0, root);
+        m_continued = rootEnd - root;
+        return true;
+    }
+
+    // Drop the rest of the root element whose part failed, see parsePart()
+    void discardRoot()
+    {
+        const size_t end = m_scanner.completed();
+        if (end == std::string::npos)
+        {
+            m_buffer.clear();
+            m_scanner.reset();
+        }
+        else
+        {
+            m_buffer.erase(0, end);
+            m_scanner.erase(0, end);
+        }
+        m_continued = 0;
+        m_discard = false;
+    }
+
+    void clear()
+    {
+        m_buffer.clear();
+        m_scanner.reset();
+        m_continued = 0;
+        m_discard = false;
+    }
+
+private: // data
+    XmlSax::Visitor& m_visitor;
+    size_t m_blockSize;
+    bool m_readAhead;
+    // Incomplete fragment followed by the last block
+    std::string m_buffer;
+    Scanner m_scanner;
+    Parts m_parts;
+    // Length of the start tag at the beginning of the buffer, of the root
+    // element continued from the previous part; 0 if there is none
+    size_t m_continued;
+    // The rest of the root element is dropped, see parsePart()
+    bool m_discard;
+    // Memory reused for the rest of the buffer following a part
+    std::string m_rest;
+};
+} // headeronly
+
+#endif // HO_SAX_STREAM_HPP_
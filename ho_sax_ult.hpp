@@ -45,8 +45,26 @@ SOFTWARE.
 
 #ifdef XmlSaxULT_Define
 
+#include <chrono>
+#include <clocale>
+#include <cmath>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <random>
 #include "ho_sax.hpp"
+#include "ho_sax_snapshot.hpp"
+#include "ho_sax_diff.hpp"
+#include "ho_sax_binder.hpp"
+#include "ho_sax_decode.hpp"
+#include "ho_xml_writer.hpp"
+#include "ho_sax_pipeline.hpp"
+#include "ho_sax_stream.hpp"
+#include "ho_sax_index.hpp"
+#include "ho_sax_hasher.hpp"
+#include "ho_sax_schema.hpp"
+#include "ho_sax_ingest.hpp"
+#include "ho_sax_namespace.hpp"
 
 namespace headeronly
 {
@@ -387,6 +405,2158 @@ InvalidStringClosingElemNoMatch + 44 // closing element
 }
 ;
 
+/// Diff ULT
+struct XmlSaxDiffULT : XmlSaxDiff::Visitor
+{
+    virtual bool added(const std::string& path)
+    {
+        m_reported += "+" + path + ";";
+        return true;
+    }
+    virtual bool removed(const std::string& path)
+    {
+        m_reported += "-" + path + ";";
+        return true;
+    }
+    virtual bool changed(const std::string& path)
+    {
+        m_reported += "*" + path + ";";
+        return true;
+    }
+    virtual bool attribute(
+        const std::string& path,
+        const std::string& name,
+        const XmlSax::String* value)
+    {
+        m_reported += "@" + path + "@" + name + "=" +
+            (value ? XmlSax::toStringValue(*value) : "null") + ";";
+        return true;
+    }
+
+    bool run()
+    {
+        struct Version
+        {
+            const char* input;
+            const char* reported;
+        };
+        static const Version versions[] =
+        {
+            { "<a><b x=\"1\"/><b>t</b></a>", "+/a[1];" },
+            { "<a>  <b x=\"1\"  />\n<b> t </b></a>", "" },
+            { "<a><b x=\"2\" y=\"3\"/><b>u</b></a>",
+                "@/a[1]/b[1]@x=2;@/a[1]/b[1]@y=3;*/a[1]/b[2];" },
+            { "<a><b y=\"3\"/><c/></a>",
+                "@/a[1]/b[1]@x=null;+/a[1]/c[1];-/a[1]/b[2];" },
+            { "<a><b y=\"3\"></a>", "" }, // parse error, no change
+            { "<z/>", "+/z[1];-/a[1];" },
+            { "<r><a bc=\"x\"/></r>", "+/r[1];-/z[1];" },
+            // Names and values are delimited in the subtree hash
+            { "<r><ab c=\"x\"/></r>", "+/r[1]/ab[1];-/r[1]/a[1];" },
+            // Text is hashed with its position among the children
+            { "<a>x<b/>y</a>", "+/a[1];-/r[1];" },
+            { "<a>xy<b/></a>", "*/a[1];" },
+            // ... and text chunks split by comments as one
+            { "<a>x<!-- c -->y<b/></a>", "" },
+            // Siblings of interleaved names are indexed by name
+            { "<a><b/><c/><b/><d/><c/><b>t</b></a>", "*/a[1];+/a[1]/c[1];+/a[1]/b[2];"
+                "+/a[1]/d[1];+/a[1]/c[2];+/a[1]/b[3];" },
+            { "<a><b/><c/><b/><d/><c>t</c><b>u</b></a>",
+                "*/a[1]/c[2];*/a[1]/b[3];" }
+        };
+
+        XmlSaxDiff diff(*this);
+        for (size_t n = 0; n < sizeof(versions)/sizeof(*versions); ++n)
+        {
+            m_reported.clear();
+            const bool parsed = diff.parse(versions[n].input);
+            if (parsed != (n != 4) || m_reported != versions[n].reported)
+                return false;
+        }
+        return true;
+    }
+
+    std::string m_reported;
+};
+
+/// Auxiliary: whole C-string as parser's content
+inline XmlSax::String str(const char* s)
+{
+    return XmlSax::String(s, s + strlen(s));
+}
+
+/// Typed conversions ULT
+struct XmlSaxConversionULT
+{
+    bool run()
+    {
+        int i = 0;
+        unsigned short u = 0;
+        long long ll = 0;
+        double d = 0;
+        bool b = false;
+        size_t index = 0;
+        static const char* const names[] = { "red", "dark <blue>" };
+
+        if (!XmlSax::parseInt(str(" \n -42\t"), i) || i != -42 ||
+            XmlSax::parseInt(str("4 2"), i) || XmlSax::parseInt(str(""), i) ||
+            XmlSax::parseInt(str("42x"), i) ||
+            XmlSax::parseInt(str("-1"), u) || XmlSax::parseInt(str("65536"), u) ||
+            !XmlSax::parseInt(str("65535"), u) || u != 65535 ||
+            !XmlSax::parseInt(str("-9223372036854775808"), ll) ||
+            ll != std::numeric_limits<long long>::min() ||
+            XmlSax::parseInt(str("9223372036854775808"), ll) ||
+            !XmlSax::parseDouble(str(" 2.5e-1 "), d) || d != 0.25 ||
+            XmlSax::parseDouble(str("1e999"), d) ||
+            XmlSax::parseDouble(str("."), d) ||
+            !XmlSax::parseBool(str(" true "), b) || !b ||
+            !XmlSax::parseBool(str("0"), b) || b ||
+            XmlSax::parseBool(str("yes"), b) ||
+            !XmlSax::parseUnescapedBool(str("\n 1 "), b) || !b ||
+            XmlSax::parseUnescapedBool(str("t&amp;"), b) ||
+            !XmlSax::parseEnum(str(" dark \n &lt;blue&gt; "), names, 2, index) ||
+            index != 1 ||
+            XmlSax::parseEnum(str("dark"), names, 2, index))
+            return false;
+
+        // Long values, special ones; the C locale's decimal point
+        // doesn't matter
+        if (!XmlSax::parseInt(str("+0000000000000000000000000000000000042"), i) ||
+            i != 42 ||
+            !XmlSax::parseInt(str("-0"), i) || i != 0 ||
+            XmlSax::parseInt(str("+"), i) || XmlSax::parseInt(str("0x1"), i) ||
+            !XmlSax::parseDouble(str(
+                "0000000000000000000000000000000000000000000000000000000001.5"), d) ||
+            d != 1.5 ||
+            !XmlSax::parseDouble(str(
+                "0.1000000000000000000000000000000000000000000000000000000000"), d) ||
+            d != 0.1 ||
+            !XmlSax::parseDouble(str(
+                "1.000000000000000000000000000000000000000000000000000000000001"), d) ||
+            d != 1 ||
+            !XmlSax::parseDouble(str("-123.456e2"), d) || d != -12345.6 ||
+            !XmlSax::parseDouble(str("1."), d) || d != 1 ||
+            !XmlSax::parseDouble(str("+.5E+1"), d) || d != 5 ||
+            !XmlSax::parseDouble(str("1200e-2"), d) || d != 12 ||
+            !XmlSax::parseDouble(str("0.000e99999999999999999999"), d) || d != 0 ||
+            !XmlSax::parseDouble(str("-INF"), d) || d != -HUGE_VAL ||
+            !XmlSax::parseDouble(str("NaN"), d) || d == d ||
+            XmlSax::parseDouble(str("1e"), d) || XmlSax::parseDouble(str("e1"), d) ||
+            XmlSax::parseDouble(str("1.2.3"), d) || XmlSax::parseDouble(str("inf"), d) ||
+            XmlSax::parseDouble(str("1,5"), d))
+            return false;
+        static const char* const commaLocales[] = {
+            "de_DE.UTF-8", "de_DE", "fr_FR.UTF-8", "pl_PL.UTF-8" };
+        const std::string locale = setlocale(LC_NUMERIC, nullptr);
+        for (auto name : commaLocales)
+        {
+            if (!setlocale(LC_NUMERIC, name))
+                continue;
+            const bool parsed = XmlSax::parseDouble(str("1.5"), d) && d == 1.5;
+            setlocale(LC_NUMERIC, locale.c_str());
+            if (!parsed)
+                return false;
+            break;
+        }
+
+        double values[6] = {};
+        size_t count = 0;
+        if (!XmlSax::parseList(str(" 1 -2.5\n\t3e2  4\r\n5 6 "), values, 6, count) ||
+            count != 6 || values[1] != -2.5 || values[2] != 300 || values[5] != 6 ||
+            XmlSax::parseList(str("1 2 3"), values, 2, count) || count != 2 ||
+            XmlSax::parseList(str("1 x 3"), values, 6, count) || count != 1 ||
+            !XmlSax::parseList(str("  "), values, 6, count) || count != 0)
+            return false;
+
+        int ints[3] = {};
+        return XmlSax::parseList(str("00 ff"), ints, 3, count) == false &&
+            XmlSax::parseList(str("7 8 9"), ints, 3, count) && ints[2] == 9;
+    }
+};
+
+/// Payload decoders ULT
+struct XmlSaxDecodeULT
+{
+    bool run()
+    {
+        unsigned char out[64];
+        size_t size = 0;
+
+        static const unsigned char hex[] = {
+            0x00, 0xff, 0x1a, 0xbf, 0x11, 0xbb, 0x7f, 0xa1 };
+        if (!XmlSaxHexDecoder::decodeAll(
+                str(" 00 ff 1a bf \n\t 11BB7f a1 "), out, sizeof(out), size) ||
+            size != sizeof(hex) || memcmp(out, hex, size) ||
+            XmlSaxHexDecoder::decodeAll(str("0"), out, sizeof(out), size) ||
+            XmlSaxHexDecoder::decodeAll(str("0g"), out, sizeof(out), size) ||
+            // White spaces are allowed between the pairs only
+            XmlSaxHexDecoder::decodeAll(str("1 a"), out, sizeof(out), size) ||
+            XmlSaxHexDecoder::decodeAll(str("0011"), out, 1, size))
+            return false;
+
+        {
+            XmlSaxHexDecoder decoder;
+            size = 0;
+            if (!decoder.decode(str("00 f"), out, sizeof(out), size) ||
+                decoder.finish() ||
+                decoder.decode(str(" f"), out, sizeof(out), size))
+                return false;
+            decoder.reset();
+            size = 0;
+            if (!decoder.decode(str("00 f"), out, sizeof(out), size) ||
+                !decoder.decode(str("f1"), out, sizeof(out), size) ||
+                decoder.finish() ||
+                !decoder.decode(str("a"), out, sizeof(out), size) ||
+                !decoder.finish() || size != 3 || out[1] != 0xff || out[2] != 0x1a)
+                return false;
+        }
+
+        static const char* const base64[][2] = {
+            { "", "" },
+            { "TWFu", "Man" },
+            { " TW\r\nE= ", "Ma" },
+            { "TQ==", "M" },
+            { "SGVsbG8s\n  IHdv\tcmxkIQ==", "Hello, world!" },
+            // Padded streams following each other
+            { "TQ==TWFu", "MMan" },
+            { "TWE= TQ==\nTWE=", "MaMMa" } };
+        for (size_t n = 0; n < sizeof(base64)/sizeof(*base64); ++n)
+        {
+            if (!XmlSaxBase64Decoder::decodeAll(
+                    str(base64[n][0]), out, sizeof(out), size) ||
+                size != strlen(base64[n][1]) || memcmp(out, base64[n][1], size))
+                return false;
+        }
+
+        static const char* const invalid[] = {
+            "TWF", "T===", "TQ=", "TQ===", "TWE==", "TW!u", "TQ=x", "TQ=TWFu" };
+        for (size_t n = 0; n < sizeof(invalid)/sizeof(*invalid); ++n)
+        {
+            if (XmlSaxBase64Decoder::decodeAll(
+                    str(invalid[n]), out, sizeof(out), size))
+                return false;
+        }
+
+        XmlSaxBase64Decoder decoder;
+        size = 0;
+        return decoder.decode(str("SGVs"), out, sizeof(out), size) &&
+            decoder.decode(str("bG8"), out, sizeof(out), size) &&
+            !decoder.finish() &&
+            decoder.decode(str("=\n"), out, sizeof(out), size) &&
+            decoder.finish() &&
+            // The next CDATA section, encoded separately
+            decoder.decode(str("TQ="), out, sizeof(out), size) &&
+            !decoder.finish() &&
+            decoder.decode(str("="), out, sizeof(out), size) &&
+            decoder.finish() && size == 6 && !memcmp(out, "HelloM", 6);
+    }
+};
+
+/// Writer ULT
+struct XmlWriterULT
+{
+    bool run()
+    {
+        std::string out;
+        {
+            XmlWriter writer(XmlWriter::stringSink(out), "  ", 4);
+            writer.enter(str("root"));
+            writer.attribute(str("a"), str("\"x\" < 'y' & z"));
+            writer.enter(str("item"), true);
+            writer.exit(str("item"), true);
+            writer.enter(str("item"));
+            writer.text(str("Tom & \"Jerry\" <3"));
+            writer.exit(str("item"));
+            writer.enter(str("data"));
+            writer.cdata(str("a]]>b]]"));
+            writer.exit(str("data"));
+            writer.exit(str("root"));
+        }
+
+        static const char* const expected =
+            "<root a=\"&quot;x&quot; &lt; &apos;y&apos; &amp; z\">\n"
+            "  <item/>\n"
+            "  <item>Tom &amp; \"Jerry\" &lt;3</item>\n"
+            "  <data><![CDATA[a]]]]><![CDATA[>b]]]]></data>\n"
+            "</root>";
+        if (out != expected)
+            return false;
+
+        // Bare '&' accepted by the parser is escaped when copied
+        static const char* const lenient =
+            "<a b=\"x & y &amp;\">Tom & Jerry &amp; &#38;&#x26;&#;&x</a>";
+        out.clear();
+        {
+            XmlWriter writer(XmlWriter::stringSink(out));
+            XmlWriterVisitor visitor(writer);
+            if (!XmlSax(visitor).parse(lenient) || !writer.flush() ||
+                out != "<a b=\"x &amp; y &amp;\">"
+                    "Tom &amp; Jerry &amp; &#38;&#x26;&amp;#;&amp;x</a>")
+                return false;
+        }
+
+        // ... and so is the '>' of "]]>" in text, even if split by a comment
+        out.clear();
+        {
+            XmlWriter writer(XmlWriter::stringSink(out));
+            XmlWriterVisitor visitor(writer);
+            if (!XmlSax(visitor).parse("<a>x]]>y]<!-- -->]>z]]<b/>></a>") ||
+                !writer.flush() ||
+                out != "<a>x]]&gt;y]]&gt;z]]<b/>></a>")
+                return false;
+        }
+
+        // Pretty-printing doesn't depend on the buffer size
+        std::string outputs[2];
+        for (size_t n = 0; n < 2; ++n)
+        {
+            XmlWriter writer(XmlWriter::stringSink(outputs[n]), " ", n ? 1024 : 1);
+            writer.text(str("t"));
+            writer.enter(str("a"));
+            writer.exit(str("a"));
+        }
+        if (outputs[0] != outputs[1] || outputs[0] != "t\n<a></a>")
+            return false;
+
+        // Nothing is written after the sink failed
+        size_t calls = 0;
+        XmlWriter failing(
+            [&calls](const char*, size_t) { ++calls; return false; }, nullptr, 16);
+        if (!failing.enter(str("root")) || failing.flush() ||
+            failing.exit(str("root")))
+            return false;
+        for (size_t n = 0; n < 100; ++n)
+        {
+            if (failing.enter(str("item")) || failing.text(str("text")) ||
+                failing.rawText(str("raw")) || failing.raw(str("<x/>")))
+                return false;
+        }
+        return !failing.flush() && calls == 1;
+    }
+};
+
+/// UTF-8 ULT
+struct XmlSaxUtf8ULT : XmlSax::Visitor
+{
+    virtual bool enter(const XmlSax::String& element, bool)
+    {
+        m_names += XmlSax::toStringName(element) + ";";
+        return true;
+    }
+    virtual bool attribute(const XmlSax::String& name, const XmlSax::String&)
+    {
+        m_names += XmlSax::toStringName(name) + ";";
+        return true;
+    }
+    virtual void error(const char*, const char* docPos)
+    {
+        m_errorPos = docPos;
+    }
+    virtual bool utf8()
+    {
+        return m_utf8;
+    }
+
+    bool parse(const char* doc, bool utf8)
+    {
+        m_names.clear();
+        m_errorPos = nullptr;
+        m_utf8 = utf8;
+        return XmlSax(*this).parse(doc);
+    }
+
+    bool run()
+    {
+        static const char* const doc =
+            "\xEF\xBB\xBF<r\xC3\xB3\xC5\xBC\xC3\xA4 "
+            "\xE5\x90\x8D\xE5\x89\x8D=\"\xF0\x9F\x98\x80\">"
+            "<p:\xC3\xA9t\xC3\xA9\xCC\x81/>"
+            "</r\xC3\xB3\xC5\xBC\xC3\xA4>";
+        static const char* const badEncoding = "<a>\xC3\x28</a>";
+        static const char* const overlong = "<a>\xC0\xAF</a>";
+        static const char* const badName = "<a \xCC\x81" "b=\"\"/>";
+
+        if (!parse(doc, true) ||
+            m_names != "r\xC3\xB3\xC5\xBC\xC3\xA4;\xE5\x90\x8D\xE5\x89\x8D;"
+                "p:\xC3\xA9t\xC3\xA9\xCC\x81;" ||
+            parse(badEncoding, true) || m_errorPos != badEncoding + 3 ||
+            !parse(badEncoding, false) ||
+            parse(overlong, true) || m_errorPos != overlong + 3 ||
+            parse(badName, true) || m_errorPos != badName ||
+            // Without validation names are ASCII only
+            parse(badName, false) || parse(doc, false))
+            return false;
+
+        // Events of the valid input preceding an invalid sequence
+        static const char* const badTail = "<a><b\xC3\xA4/>\xC3</a>";
+        if (parse(badTail, true) || m_errorPos != badTail + 9 ||
+            m_names != "a;b\xC3\xA4;")
+            return false;
+
+        // Snapshots validate as the visitor asks
+        std::string snapshot;
+        m_errorPos = nullptr;
+        m_utf8 = true;
+        if (XmlSaxSnapshot::create(badEncoding, *this, snapshot) ||
+            !snapshot.empty() || m_errorPos != badEncoding + 3)
+            return false;
+        m_utf8 = false;
+        if (!XmlSaxSnapshot::create(badEncoding, *this, snapshot))
+            return false;
+
+        std::string out;
+        static const char le[] = "\xFF\xFE<\0a\0/\0>\0=\xD8\x00\xDE";
+        static const char be[] = "\0<\0a\0>\x20\xAC\0<\0/\0a\0>";
+        return XmlSax::transcodeUtf16(le, sizeof(le) - 1, out) &&
+            out == "<a/>\xF0\x9F\x98\x80" &&
+            XmlSax::transcodeUtf16(be, sizeof(be) - 1, out) &&
+            out == "<a>\xE2\x82\xAC</a>" &&
+            !XmlSax::transcodeUtf16("<a/>", 4, out) &&
+            !XmlSax::transcodeUtf16(le, 12, out);
+    }
+
+    std::string m_names;
+    const char* m_errorPos;
+    bool m_utf8;
+};
+
+/// Fragments stream ULT
+struct XmlSaxFragmentsULT : XmlSax::Visitor
+{
+    virtual bool enter(const XmlSax::String& element, bool)
+    {
+        m_events += "<" + XmlSax::toStringName(element);
+        return true;
+    }
+    virtual bool fragment(const XmlSax::String& fragment)
+    {
+        m_events += "[" + std::string(fragment.first, fragment.second) + "]";
+        return true;
+    }
+    virtual bool doctype(const XmlSax::String&)
+    {
+        m_events += "D";
+        return true;
+    }
+    virtual void error(const char*, const char* docPos)
+    {
+        m_events += "!" + std::to_string(docPos - m_doc);
+    }
+
+    bool parse(const char* doc, bool recover, const char** remainder = nullptr)
+    {
+        m_events.clear();
+        m_doc = doc;
+        return XmlSax(*this).parseFragments(doc, recover, remainder);
+    }
+
+    bool run()
+    {
+        static const char* const stream =
+            "<?xml version=\"1.0\"?>\n<a>1</a>\n<!-- c --><b/>  "
+            "<?xml version=\"1.0\"?>\n<c x=\"1\"><d/></c>\n";
+        static const char* const broken = "<a></b> <c/>junk<d/> <e>";
+        static const char* const chunk1 = "<a>1</a>\n<b><c x=\"/>";
+        static const char* const chunk2 = "<b><c x=\"/>\"/></b>";
+        // Document type declarations aren't taken for elements
+        static const char* const doctypes =
+            "<!DOCTYPE a [<!ELEMENT a (#PCDATA)>]>\n<a>1</a>"
+            "<?xml version=\"1.0\"?><!DOCTYPE b [<!ELEMENT b EMPTY>]><b/>"
+            "<!DOCTYPE c [<!ELEMENT c EMP";
+
+        const char* remainder = nullptr;
+        if (!parse(stream, false) ||
+            m_events != "<a[<a>1</a>]<b[<b/>]<c<d[<c x=\"1\"><d/></c>]" ||
+            parse(broken, false) || m_events != "<a!3" ||
+            parse(broken, true) || m_events != "<a!3<c[<c/>]!12<d[<d/>]<e!24" ||
+            !parse(chunk1, false, &remainder) || m_events != "<a[<a>1</a>]" ||
+            remainder != chunk1 + 9 ||
+            !parse(chunk2, false, &remainder) || *remainder ||
+            m_events != "<b<c[<b><c x=\"/>\"/></b>]" ||
+            !parse(doctypes, false, &remainder) ||
+            m_events != "D<a[<a>1</a>]D<b[<b/>]" ||
+            remainder != strstr(doctypes, "<!DOCTYPE c"))
+            return false;
+
+        // Stopped by a callback
+        struct Stop : XmlSaxFragmentsULT
+        {
+            virtual bool fragment(const XmlSax::String&)
+            {
+                return false;
+            }
+        } stop;
+        return !stop.parse("<a/><b/>", true) && stop.m_events == "<a";
+    }
+
+    std::string m_events;
+    const char* m_doc;
+};
+
+/// Pipeline ULT
+struct XmlSaxPipelineULT
+{
+    // Records the events in a compact form
+    struct Recorder : XmlSax::Visitor
+    {
+        Recorder(XmlSaxFanOut* fanOut = nullptr, const char* skipped = "",
+                size_t stopAfter = 0):
+            m_fanOut(fanOut),
+            m_skipped(skipped),
+            m_stopAfter(stopAfter)
+        {}
+
+        virtual bool enter(const XmlSax::String& element, bool)
+        {
+            const std::string name = XmlSax::toStringName(element);
+            m_events += "<" + name;
+            if (name == m_skipped)
+                m_fanOut->skip();
+            return !m_stopAfter || --m_stopAfter;
+        }
+        virtual bool exit(const XmlSax::String& element, bool)
+        {
+            m_events += ">" + XmlSax::toStringName(element);
+            return true;
+        }
+        virtual bool attribute(
+            const XmlSax::String& name,
+            const XmlSax::String& value)
+        {
+            m_events += " " + XmlSax::toStringName(name) + "=" +
+                XmlSax::toStringValue(value);
+            return true;
+        }
+        virtual bool text(const XmlSax::String& content)
+        {
+            m_events += "'" + XmlSax::toStringText(content);
+            return true;
+        }
+
+        XmlSaxFanOut* m_fanOut;
+        std::string m_skipped;
+        size_t m_stopAfter;
+        std::string m_events;
+    };
+
+    bool run()
+    {
+        static const char* const doc =
+            "<r a=\"1\"><b x=\"2\" y=\"3\">t<c/></b><d y=\"4\">u</d></r>";
+
+        XmlSaxFanOut fanOut;
+        Recorder all;
+        Recorder skipping(&fanOut, "b");
+        Recorder stopping(nullptr, "", 2);
+        Recorder filtered;
+        XmlSaxAttributeProjection projection(filtered);
+        projection.add("y");
+        XmlSaxDropElement drop(projection);
+        drop.add("c");
+        XmlSaxRename rename(drop);
+        rename.add("d", "renamed").add("b", "c");
+
+        fanOut.add(all).add(skipping).add(stopping).add(rename);
+        if (!XmlSax(fanOut).parse(doc) ||
+            all.m_events != "<r a=1<b x=2 y=3't<c>c>b<d y=4'u>d>r" ||
+            skipping.m_events != "<r a=1<b x=2 y=3>b<d y=4'u>d>r" ||
+            stopping.m_events != "<r a=1<b" ||
+            filtered.m_events != "<r<renamed y=4'u>renamed>r" ||
+            fanOut.isActive(2) || !fanOut.isActive(3))
+            return false;
+
+        // Parsing stops when all visitors are stopped
+        XmlSaxFanOut stopped;
+        Recorder stopping1(nullptr, "", 1);
+        Recorder stopping2(nullptr, "", 2);
+        stopped.add(stopping1).add(stopping2);
+        return !XmlSax(stopped).parse(doc) && stopping2.m_events == "<r a=1<b";
+    }
+};
+
+/// Stream ULT
+struct XmlSaxStreamULT : XmlSax::Visitor
+{
+    virtual bool enter(const XmlSax::String& element, bool)
+    {
+        m_events += "<" + XmlSax::toStringName(element);
+        return true;
+    }
+    virtual bool text(const XmlSax::String& content)
+    {
+        m_events += "'" + std::string(content.first, content.second);
+        return true;
+    }
+    virtual bool fragment(const XmlSax::String& fragment)
+    {
+        m_events += "[" + std::string(fragment.first, fragment.second) + "]";
+        return true;
+    }
+    virtual void error(const char*, const char*)
+    {
+        m_events += "!";
+    }
+
+    // Source passing the document in chunks of given size
+    static XmlSaxStream::Source source(const std::string& doc, size_t chunk,
+        size_t failAt = std::string::npos)
+    {
+        auto pos = std::make_shared<size_t>(0);
+        return [&doc, chunk, failAt, pos](char* buffer, size_t capacity,
+            size_t& size)
+        {
+            if (*pos >= failAt)
+                return false;
+            size = std::min(std::min(chunk, capacity), doc.size() - *pos);
+            memcpy(buffer, doc.data() + *pos, size);
+            *pos += size;
+            return true;
+        };
+    }
+
+    bool run()
+    {
+        static const std::string doc =
+            "<?xml version=\"1.0\"?>\n<a>1</a>\n<!-- c --><b/>  "
+            "<c x=\"1\"><d>\xc5\x82</d></c>\n<e>text</e>"
+            "<f x=\"a/\"><![CDATA[</f>]]]]><!-- </f> - --></f><!----><g/>"
+            "<!DOCTYPE h [<!ELEMENT h (#PCDATA)>]><h>x</h>";
+
+        m_events.clear();
+        XmlSax(*this).parseFragments(doc.c_str());
+        const std::string expected = m_events;
+
+        for (size_t block = 1; block < 20; ++block)
+        {
+            for (int readAhead = 0; readAhead < 2; ++readAhead)
+            {
+                m_events.clear();
+                XmlSaxStream stream(*this, block, readAhead != 0);
+                if (!stream.parse(source(doc, block + 3)) || m_events != expected)
+                    return false;
+            }
+        }
+
+        // Truncated input, read failure
+        m_events.clear();
+        if (XmlSaxStream(*this, 4).parse(source("<a/><b>", 2)) ||
+            m_events != "<a[<a/>]<b!")
+            return false;
+        m_events.clear();
+        if (XmlSaxStream(*this, 4).parse(source(doc, 4, 30)) ||
+            m_events != "<a'1[<a>1</a>]!")
+            return false;
+        if (!runParts())
+            return false;
+
+#ifdef HO_SAX_ZSTD
+        // Compressed input, blocks smaller than the decoder's output;
+        // and truncated one, missing only the frame's checksum
+        std::string compressed(ZSTD_compressBound(doc.size()), '\0');
+        ZSTD_CCtx* const context = ZSTD_createCCtx();
+        ZSTD_CCtx_setParameter(context, ZSTD_c_checksumFlag, 1);
+        compressed.resize(ZSTD_compress2(context,
+            &compressed[0], compressed.size(), doc.data(), doc.size()));
+        ZSTD_freeCCtx(context);
+        for (size_t cut = 0; cut <= 4; cut += 4)
+        {
+            FILE* file = tmpfile();
+            if (!file)
+                return false;
+            fwrite(compressed.data(), 1, compressed.size() - cut, file);
+            rewind(file);
+            m_events.clear();
+            const bool parsed = XmlSaxStream(*this, 5).parse(
+                XmlSaxStream::zstdSource(file));
+            fclose(file);
+            // All the content is decoded, then the truncation is an error
+            if (parsed != !cut || m_events != expected + (cut ? "!" : ""))
+                return false;
+        }
+#endif // HO_SAX_ZSTD
+        return true;
+    }
+
+    // Events of big documents parsed in parts, and the buffer size
+    struct Parts : XmlSax::Visitor
+    {
+        virtual bool enter(const XmlSax::String& element, bool)
+        {
+            m_events += "<" + XmlSax::toStringName(element);
+            m_buffered = std::max(m_buffered, m_stream ? m_stream->buffered() : 0);
+            return true;
+        }
+        virtual bool exit(const XmlSax::String& element, bool)
+        {
+            m_events += ">" + XmlSax::toStringName(element);
+            return true;
+        }
+        virtual bool attribute(const XmlSax::String& name, const XmlSax::String& value)
+        {
+            m_events += " " + XmlSax::toStringName(name) + "=" +
+                XmlSax::toStringValue(value);
+            return true;
+        }
+        virtual bool text(const XmlSax::String& content)
+        {
+            m_events += "'" + XmlSax::toStringText(content);
+            return true;
+        }
+        virtual bool fragment(const XmlSax::String& fragment)
+        {
+            m_events += fragment.first[1] == 'b' ? "[big]" :
+                "[" + std::string(fragment.first, fragment.second) + "]";
+            return true;
+        }
+        virtual bool span(const XmlSax::String& element, const XmlSax::String&,
+            const XmlSax::String&)
+        {
+            m_events += "~" + XmlSax::toStringName(element);
+            return true;
+        }
+        virtual void error(const char*, const char*)
+        {
+            m_events += "!";
+        }
+        virtual bool spans()
+        {
+            return true;
+        }
+
+        std::string m_events;
+        const XmlSaxStream* m_stream = nullptr;
+        size_t m_buffered = 0;
+    };
+
+    bool runParts()
+    {
+        // Documents much bigger than the blocks, parsed in parts
+        std::string items;
+        for (int i = 0; i < 4000; ++i)
+            items += "<item id=\"" + std::to_string(i) + "\"><v>" +
+                std::string(i % 50, 'x') + " &amp; " + std::to_string(i) +
+                "</v></item>\n";
+        const std::string doc = "<?xml version=\"1.0\"?>\n<big n=\"1\">" +
+            items + "</big>\n<a>1</a><big>" + items + "<x/></big>";
+
+        Parts expected;
+        XmlSax(expected).parseFragments(doc.c_str());
+        // No span of the roots parsed in parts
+        std::string events;
+        for (size_t pos = 0; pos < expected.m_events.size(); ++pos)
+        {
+            if (!expected.m_events.compare(pos, 5, "~big>"))
+                pos += 3;
+            else
+                events += expected.m_events[pos];
+        }
+
+        for (int readAhead = 0; readAhead < 2; ++readAhead)
+        {
+            Parts parts;
+            XmlSaxStream stream(parts, 1000, readAhead != 0);
+            parts.m_stream = &stream;
+            if (!stream.parse(source(doc, 777)) || parts.m_events != events ||
+                parts.m_buffered > XmlSaxStream::MinPartSize + 3000)
+                return false;
+        }
+
+        // A failed part, the rest of its root element is skipped
+        std::string bad = doc;
+        bad.replace(bad.find("<item id=\"3000\">"), 1, "<<");
+        Parts parts;
+        if (XmlSaxStream(parts, 1000).parse(source(bad, 1000), true))
+            return false;
+        const size_t failed = events.find("<item id=3000");
+        const size_t next = events.find("<a'1", failed);
+        if (parts.m_events.compare(0, failed, events, 0, failed) ||
+            parts.m_events.compare(failed, std::string::npos, "!" + events.substr(next)))
+            return false;
+
+        // Source throwing an exception
+        for (int readAhead = 0; readAhead < 2; ++readAhead)
+        {
+            Parts thrown;
+            size_t calls = 0;
+            const bool parsed = XmlSaxStream(thrown, 4, readAhead != 0).parse(
+                [&calls](char* buffer, size_t capacity, size_t& size)
+                {
+                    if (++calls > 1)
+                        throw std::bad_alloc();
+                    size = std::min<size_t>(capacity, 4);
+                    memcpy(buffer, "<a/>", size);
+                    return true;
+                });
+            if (parsed || thrown.m_events != "<a~a>a[<a/>]!")
+                return false;
+        }
+        return true;
+    }
+
+    std::string m_events;
+};
+
+/// Index ULT
+struct XmlSaxIndexULT : XmlSax::Visitor
+{
+    virtual bool enter(const XmlSax::String& element, bool isEmptyElementTag)
+    {
+        m_events += (isEmptyElementTag ? "<" : "(") +
+            XmlSax::toStringName(element);
+        return true;
+    }
+    virtual bool exit(const XmlSax::String& element, bool)
+    {
+        m_events += ")" + XmlSax::toStringName(element);
+        return true;
+    }
+    virtual bool attribute(const XmlSax::String& name, const XmlSax::String& value)
+    {
+        m_events += " " + XmlSax::toStringName(name) + "=" +
+            XmlSax::toStringValue(value);
+        return true;
+    }
+    virtual bool text(const XmlSax::String& content)
+    {
+        m_events += "'" + XmlSax::toStringText(content);
+        return true;
+    }
+    virtual void error(const char*, const char* docPos)
+    {
+        m_errorPos = docPos;
+    }
+
+    bool run()
+    {
+        static const char* const doc =
+            "<?xml version=\"1.0\"?>\n"
+            "<export v=\"2\">\n"
+            "  <part n=\"a>b\">\n"
+            "    <record id=\"7\"><x>1</x></record>\n"
+            "    <record id=\"3\" t=\"\"/>\n"
+            "  </part>\n"
+            "  <part><record id=\" 5 \"><x>2</x></record  ></part>\n"
+            "  <record id=\"9\"/>\n"
+            "</export>";
+
+        XmlSaxIndex index;
+        if (!index.build(doc, "/export/*/record", "id") ||
+            index.entries().size() != 3 || index.docSize() != strlen(doc) ||
+            index.find("3") != &index.entries()[1] || index.find("9") ||
+            !index.find("5") || index.find("1"))
+            return false;
+
+        const XmlSaxIndex::Entry& first = index.entries()[0];
+        if (first.depth != 3 || first.ancestors.size() != 2 ||
+            std::string(doc + first.offset, first.length) !=
+                "<record id=\"7\"><x>1</x></record>" ||
+            std::string(doc + index.entries()[2].offset,
+                index.entries()[2].length) !=
+                "<record id=\" 5 \"><x>2</x></record  >" ||
+            index.findOffset(first.offset + 20) != &first ||
+            index.findOffset(first.offset - 1))
+            return false;
+
+        // Offsets between the entries, and after the last one
+        static const char* const flat = "<r><a>1</a> <b/>\n<c><d/></c></r>";
+        XmlSaxIndex flatIndex;
+        if (!flatIndex.build(flat, "/r/*") || flatIndex.entries().size() != 3 ||
+            flatIndex.findOffset(strstr(flat, " <b") - flat) ||
+            flatIndex.findOffset(strstr(flat, "\n") - flat) ||
+            flatIndex.findOffset(strstr(flat, "</r>") - flat) ||
+            flatIndex.findOffset(strstr(flat, "<d") - flat) !=
+                &flatIndex.entries()[2] ||
+            flatIndex.findOffset(strstr(flat, "<b") - flat) !=
+                &flatIndex.entries()[1])
+            return false;
+
+        // Round trip of the blob; damaged one
+        std::string blob;
+        index.save(blob);
+        XmlSaxIndex loaded;
+        if (!loaded.load(blob.data(), blob.size()) ||
+            loaded.path() != "/export/*/record" ||
+            loaded.find("5") != &loaded.entries()[2] ||
+            loaded.load(blob.data(), blob.size() - 1) ||
+            !loaded.entries().empty())
+            return false;
+
+        // Length of the first entry, with which its end overflows
+        std::string crafted = blob;
+        const size_t length = 4 + 4 + 8 + 4 + index.path().size() +
+            4 + index.keyAttribute().size() + 8 + 8;
+        memset(&crafted[length], 0xFF, sizeof(uint64_t));
+        if (loaded.load(crafted.data(), crafted.size()))
+            return false;
+
+        // Subtree with the ancestors' context, from memory and from file
+        static const char* const expected =
+            "(export v=2(part n=a>b(record id=7(x'1)x)record)part)export";
+        m_events.clear();
+        if (!index.parseAt(doc, *index.find("7"), *this) ||
+            m_events != expected)
+            return false;
+        m_events.clear();
+        if (!index.parseAt(doc, *index.find("3"), *this, false) ||
+            m_events != "<record id=3 t=)record")
+            return false;
+
+        FILE* file = tmpfile();
+        if (!file)
+            return false;
+        fputs(doc, file);
+        m_events.clear();
+        const bool fromFile = index.parseAt(file, *index.find("7"), *this);
+        fclose(file);
+        if (!fromFile || m_events != expected)
+            return false;
+
+        // Stale index: an ancestor's offset doesn't point to a start tag
+        std::string stale = doc;
+        stale.replace(stale.find("<export"), 2, "x<");
+        if (index.parseAt(stale.c_str(), *index.find("7"), *this))
+            return false;
+
+        // Error positions point into the document
+        static const char* const broken = "<r><a><b></a></r>";
+        m_errorPos = nullptr;
+        return index.build("<r><a><b/></a></r>", "/r/a") &&
+            index.entries().size() == 1 &&
+            !index.parseAt(broken, index.entries()[0], *this) &&
+            m_errorPos == broken + 9;
+    }
+
+    std::string m_events;
+    const char* m_errorPos;
+};
+
+/// Hasher ULT
+struct XmlSaxHasherULT : XmlSaxHasher
+{
+    XmlSaxHasherULT(xmlsaxhash::Algorithm algorithm = xmlsaxhash::Fnv64):
+        XmlSaxHasher(algorithm)
+    {}
+
+    virtual bool subtree(const XmlSax::String& element, size_t depth,
+        const Digest& digest)
+    {
+        if (XmlSax::toStringName(element) == "b")
+            m_subtrees.push_back(std::make_pair(depth, digest));
+        return true;
+    }
+
+    static std::string hex(xmlsaxhash::Algorithm algorithm, const char* s)
+    {
+        xmlsaxhash::Context context(algorithm);
+        context.update(s, strlen(s));
+        return context.finish().hex();
+    }
+
+    bool run()
+    {
+        // Known answers
+        if (hex(xmlsaxhash::Fnv64, "a") != "af63dc4c8601ec8c" ||
+            hex(xmlsaxhash::Fnv128, "a") != "d228cb696f1a8caf78912b704e4a8964" ||
+            hex(xmlsaxhash::Sha256, "abc") !=
+                "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" ||
+            hex(xmlsaxhash::Sha256,
+                "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") !=
+                "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1")
+            return false;
+
+        static const char* const doc1 =
+            "<r x=\"1\" y=\"a  b\"><b>Tom &amp; Jerry</b>\n  <c/></r>";
+        static const char* const doc2 =
+            "<?xml version=\"1.0\"?><!-- config -->\n<r y=\"a b\"  x=\"1\">"
+            "<b>\n  Tom  &amp;\tJerry </b><!-- c --><c></c>\n</r>\n";
+        static const char* const changed[] = {
+            "<r x=\"1\" y=\"ab\"><b>Tom &amp; Jerry</b><c/></r>",
+            "<r x=\"1\" y=\"a b\"><b>Tom &amp; Jerry</b><c/><c/></r>",
+            "<r x=\"1\" y=\"a b\"><b>Tom &amp; Jerry</b><d/></r>",
+            "<r x=\"1\" y=\"a b\"><b><![CDATA[Tom & Jerry]]></b><c/></r>",
+            "<r x=\"1\" y=\" a b\"><b>Tom &amp; Jerry</b><c/></r>" };
+
+        for (auto algorithm :
+            { xmlsaxhash::Fnv64, xmlsaxhash::Fnv128, xmlsaxhash::Sha256 })
+        {
+            XmlSaxHasherULT hasher(algorithm);
+            Digest digest1, digest2;
+            if (!hasher.parse(doc1, digest1) || !hasher.parse(doc2, digest2) ||
+                digest1 != digest2 ||
+                hasher.m_subtrees.size() != 2 ||
+                hasher.m_subtrees[0].first != 2 ||
+                hasher.m_subtrees[0].second != hasher.m_subtrees[1].second)
+                return false;
+
+            for (auto doc : changed)
+            {
+                Digest digest;
+                if (!hasher.parse(doc, digest) || digest == digest1)
+                    return false;
+            }
+
+            // Text split by a comment is one run
+            Digest split, joined, unspaced;
+            if (!hasher.parse("<r>foo <!-- c --> bar</r>", split) ||
+                !hasher.parse("<r>foo bar</r>", joined) ||
+                !hasher.parse("<r>foo<!-- c -->bar</r>", unspaced) ||
+                split != joined || unspaced == joined)
+                return false;
+
+            // Repeated attribute names keep their document order
+            Digest repeated1, repeated2, swapped;
+            if (!hasher.parse("<r b=\"x\" a=\"1\" a=\"2\"/>", repeated1) ||
+                !hasher.parse("<r a=\"1\" b=\"x\" a=\"2\"/>", repeated2) ||
+                !hasher.parse("<r a=\"2\" b=\"x\" a=\"1\"/>", swapped) ||
+                repeated1 != repeated2 || swapped == repeated1)
+                return false;
+        }
+
+        // Fragments hashed together
+        XmlSaxHasherULT hasher;
+        Digest digest;
+        hasher.parse("<a/>", digest);
+        hasher.reset();
+        return XmlSax(hasher).parseFragments("<a/>\n<a/>") &&
+            hasher.digest() != digest;
+    }
+
+    std::vector<std::pair<size_t, Digest> > m_subtrees;
+};
+
+/// Schema ULT
+struct XmlSaxSchemaULT : XmlSax::Visitor
+{
+    virtual bool enter(const XmlSax::String& element, bool)
+    {
+        m_events += "<" + XmlSax::toStringName(element);
+        return true;
+    }
+    virtual void error(const char* info, const char* docPos)
+    {
+        m_error = info;
+        m_errorPos = docPos;
+    }
+
+    // Return position of the error, or -1 if doc is valid
+    int validate(const XmlSaxSchema* schema, const char* doc)
+    {
+        m_events.clear();
+        m_error.clear();
+        m_errorPos = nullptr;
+        bool valid = false;
+        if (schema)
+        {
+            XmlSaxValidator validator(*this, *schema);
+            valid = XmlSax(validator).parse(doc);
+        }
+        else
+        {
+            XmlSaxValidator validator(*this);
+            valid = XmlSax(validator).parse(doc);
+        }
+        return valid ? -1 : static_cast<int>(m_errorPos - doc);
+    }
+
+    bool run()
+    {
+        XmlSaxSchema schema;
+        if (!schema.element("book", "(title, (chapter | appendix)*, index?)+") ||
+            !schema.element("title", "(#PCDATA)") ||
+            !schema.element("chapter", "(#PCDATA|b|i)*") ||
+            !schema.element("appendix", "ANY") ||
+            !schema.element("index", "EMPTY") ||
+            !schema.element("b", "(#PCDATA)") ||
+            !schema.attribute("book", "id", true) ||
+            !schema.attribute("book", "lang") ||
+            schema.element("i", "(#PCDATA|b)") ||
+            schema.element("i", "(a,b|c)") ||
+            schema.element("i", "(a") ||
+            schema.element("title", "ANY") ||
+            !schema.element("i", "(#PCDATA)"))
+            return false;
+
+        struct Case
+        {
+            const char* doc;
+            int errorPos;
+        } cases[] = {
+            { "<book id=\"1\">\n  <title>T</title><chapter>x <b>y</b></chapter>"
+              "<appendix><b/></appendix><index/><title/></book>", -1 },
+            { "<book lang=\"en\" id=\"1\"><title/></book>", -1 },
+            // Required attribute, undeclared attribute
+            { "<book><title/></book>", 1 },
+            { "<book id=\"1\" x=\"\"><title/></book>", 13 },
+            // Content model violations
+            { "<book id=\"1\"><chapter/></book>", 14 },
+            { "<book id=\"1\"><title/><index/><chapter/></book>", 30 },
+            { "<book id=\"1\"></book>", 15 },
+            { "<book id=\"1\"><title/>text</book>", 21 },
+            { "<book id=\"1\"><title/><index>x</index></book>", 28 },
+            { "<book id=\"1\"><title/><index><b/></index></book>", 29 },
+            { "<book id=\"1\"><title/><chapter><i><b/></i></chapter></book>", 34 },
+            { "<book id=\"1\"><title/><unknown/></book>", 22 } };
+
+        for (const auto& c : cases)
+        {
+            if (validate(&schema, c.doc) != c.errorPos)
+                return false;
+        }
+
+        // Declarations of the document
+        static const char* const dtd =
+            "<?xml version=\"1.0\"?>\n"
+            "<!DOCTYPE list [\n"
+            "  <!-- items -->\n"
+            "  <!ELEMENT list (item+)>\n"
+            "  <!ELEMENT item (#PCDATA)>\n"
+            "  <!ATTLIST item id CDATA #REQUIRED>\n"
+            "  <!ATTLIST list kind (a|b) \"a\" ver CDATA #FIXED \"1\">\n"
+            "]>\n";
+        if (validate(nullptr, (std::string(dtd) +
+                "<list kind=\"b\"><item id=\"1\">x</item></list>").c_str()) != -1 ||
+            m_events != "<list<item" ||
+            validate(nullptr, (std::string(dtd) +
+                "<list><item id=\"1\"/><item/></list>").c_str()) !=
+                static_cast<int>(strlen(dtd)) + 21 ||
+            validate(nullptr, "<a><b/></a>") != -1)
+            return false;
+
+        XmlSaxSchema parsed;
+        return !parsed.dtd(str("<!ELEMENT a (b,)>")) &&
+            !parsed.dtd(str("%entity; <!ELEMENT a ANY>")) &&
+            parsed.dtd(str("<!ENTITY e \"<x>\"> <!ELEMENT a ANY>"));
+    }
+
+    std::string m_events;
+    std::string m_error;
+    const char* m_errorPos;
+};
+
+/// Memory reuse ULT
+struct XmlSaxMemoryULT : XmlSax::Visitor
+{
+    XmlSaxMemoryULT():
+        m_depth(0),
+        m_maxDepth(0)
+    {}
+
+    virtual bool enter(const XmlSax::String&, bool isEmptyElementTag)
+    {
+        if (!isEmptyElementTag)
+            m_maxDepth = std::max(m_maxDepth, ++m_depth);
+        return true;
+    }
+    virtual bool exit(const XmlSax::String&, bool isEmptyElementTag)
+    {
+        if (!isEmptyElementTag)
+            --m_depth;
+        return true;
+    }
+    virtual void error(const char* info, const char*)
+    {
+        m_error = info;
+    }
+
+    bool run()
+    {
+        // Conversions into a reused buffer
+        std::string s;
+        s.reserve(64);
+        const char* const buffer = s.data();
+        XmlSax::toStringText(str("  Tom \n &amp;  Jerry "), s);
+        if (s != "Tom & Jerry" || s.data() != buffer)
+            return false;
+        XmlSax::toStringValue(str("  a &amp;quot; \t b "), s);
+        if (s != " a &quot; b " || s.data() != buffer)
+            return false;
+        XmlSax::toStringCdata(str("\n x &lt; "), s);
+        if (s != "x &lt;" || s.data() != buffer)
+            return false;
+        XmlSax::toStringName(str("ns:name"), s);
+        if (s != "ns:name" || s.data() != buffer)
+            return false;
+
+        // Nesting deeper than the node stack's inline storage
+        std::string doc;
+        for (int n = 0; n < 100; ++n)
+            doc += "<e" + std::to_string(n) + " a=\"1\">";
+        doc += "<x/>";
+        for (int n = 99; n >= 0; --n)
+            doc += "</e" + std::to_string(n) + ">";
+
+        XmlSax sax(*this);
+        if (!sax.parse(doc.c_str()) || m_maxDepth != 100 || m_depth ||
+            !sax.parse(doc.c_str()) || m_maxDepth != 100 || m_depth)
+            return false;
+
+        const size_t pos = doc.find("</e60>");
+        doc.replace(pos, 6, "</e61>");
+        return !sax.parse(doc.c_str()) && m_error ==
+            "ERROR: closing attribute statement mismatch; expected \"e60\"";
+    }
+
+    size_t m_depth;
+    size_t m_maxDepth;
+    std::string m_error;
+};
+
+/// Ingestion ULT
+struct XmlSaxIngestULT
+{
+    // Counts elements of the parsed files
+    struct Counter : XmlSaxIngest::Visitor
+    {
+        Counter():
+            m_elements(0),
+            m_files(0),
+            m_failed(0)
+        {}
+
+        virtual bool begin(const std::string& path)
+        {
+            return path != "skip";
+        }
+        virtual void end(const std::string&, XmlSaxIngest::Result result)
+        {
+            if (result == XmlSaxIngest::Parsed)
+                ++m_files;
+            else
+                ++m_failed;
+        }
+        virtual bool enter(const XmlSax::String& element, bool)
+        {
+            if (*element.first == 't')
+                throw std::runtime_error("visitor");
+            ++m_elements;
+            return true;
+        }
+
+        size_t m_elements;
+        size_t m_files;
+        size_t m_failed;
+    };
+
+    bool run()
+    {
+        // File n holds n + 1 elements; "missing" cannot be read,
+        // reading "unreadable" and parsing "thrown" throw exceptions
+        std::vector<std::string> paths;
+        for (int n = 0; n < 200; ++n)
+            paths.push_back(std::to_string(n));
+        paths.push_back("missing");
+        paths.push_back("skip");
+        paths.push_back("broken");
+        paths.push_back("unreadable");
+        paths.push_back("thrown");
+
+        const XmlSaxIngest::Reader reader =
+            [](const std::string& path, std::string& buffer)
+            {
+                if (path == "missing")
+                    return false;
+                if (path == "unreadable")
+                    throw std::bad_alloc();
+                buffer = "<r>";
+                if (path == "broken")
+                    buffer += "</x>";
+                if (path == "thrown")
+                    buffer += "<t/>";
+                for (int n = 0; path != "skip" && n < atoi(path.c_str()); ++n)
+                    buffer += "<e/>";
+                buffer += "</r>";
+                return true;
+            };
+
+        for (size_t buffers = 1; buffers < 6; buffers += 4)
+        {
+            std::vector<Counter> counters(3);
+            std::vector<XmlSaxIngest::Visitor*> visitors;
+            for (auto& c : counters)
+                visitors.push_back(&c);
+
+            XmlSaxIngest ingest(visitors, 2, buffers, reader);
+            size_t elements = 0;
+            size_t files = 0;
+            size_t failed = 0;
+            if (ingest.run(paths) != 200)
+                return false;
+            for (const auto& c : counters)
+            {
+                elements += c.m_elements;
+                files += c.m_files;
+                failed += c.m_failed;
+            }
+            // "broken" and "thrown" report their root elements
+            if (elements != 200 * 201 / 2 + 2 || files != 200 || failed != 5)
+                return false;
+        }
+        return true;
+    }
+};
+
+/// Statement dispatch ULT: error positions of malformed statements
+struct XmlSaxDispatchULT : XmlSax::Visitor
+{
+    virtual void error(const char*, const char* docPos)
+    {
+        m_errorPos = docPos;
+    }
+
+    bool run()
+    {
+        struct Case
+        {
+            const char* doc;
+            int errorPos;
+        } cases[] = {
+            { "<a>text", 3 },
+            { "<a></ a>", 3 },
+            { "<a><!x></a>", 3 },
+            { "<a><![CDATA[x]></a>", 3 },
+            { "<a><?pi x></a>", 3 },
+            { "<a><b x=1/></a>", 3 },
+            { "<a><b/><", 7 },
+            { "<a>\n <!-- c --> <b/>t<!-- c -->", 31 } };
+
+        for (const auto& c : cases)
+        {
+            m_errorPos = nullptr;
+            if (XmlSax(*this).parse(c.doc) || m_errorPos != c.doc + c.errorPos)
+                return false;
+        }
+        return XmlSax(*this).parse("<a>x<![CDATA[y]]><?pi?>z</a>");
+    }
+
+    const char* m_errorPos;
+};
+
+/// Feature selection ULT: disabled constructs are errors
+struct XmlSaxFeaturesULT : XmlSax::Visitor
+{
+    virtual void error(const char* info, const char*)
+    {
+        m_error = info;
+    }
+
+    template <unsigned Features>
+    bool check(const char* doc, const char* error)
+    {
+        m_error.clear();
+        return XmlSaxParser<Features>(*this).parse(doc) == !*error && m_error == error;
+    }
+
+    bool run()
+    {
+        using namespace xmlsax;
+        static const char* const disabled = "ERROR: namespace prefixes disabled";
+        return check<AllFeatures>("<?xml version=\"1.0\"?><!DOCTYPE a [<!ELEMENT a ANY>]>"
+                "<a><![CDATA[x]]><?pi?><p:b/></a>", "") &&
+            check<AllFeatures & ~XmlDeclaration>("<?xml version=\"1.0\"?><a/>",
+                "ERROR: XML Declaration disabled") &&
+            check<AllFeatures & ~Doctype>("<!DOCTYPE a [<!ELEMENT a ANY>]><a/>",
+                "ERROR: DOCTYPE disabled") &&
+            check<AllFeatures & ~Cdata>("<a><![CDATA[x]]></a>", "ERROR: CDATA disabled") &&
+            check<AllFeatures & ~Pi>("<a><?pi?></a>", "ERROR: Processing Instructions disabled") &&
+            check<AllFeatures & ~Pi>("<a>x</a>", "") &&
+            // The reserved prefixes are not namespace prefixes
+            check<AllFeatures & ~Namespaces>("<a xml:lang=\"en\" xmlns:p=\"u\"><b/></a>", "") &&
+            check<AllFeatures & ~Namespaces>("<p:a/>", disabled) &&
+            check<AllFeatures & ~Namespaces>("<a p:b=\"1\"/>", disabled) &&
+            check<AllFeatures & ~Namespaces>("<xml:a/>", disabled);
+    }
+
+    std::string m_error;
+};
+
+/// Lint ULT
+struct XmlSaxLintULT : XmlSax::Visitor
+{
+    XmlSaxLintULT():
+        m_stopAt(nullptr)
+    {}
+
+    virtual bool enter(const XmlSax::String& element, bool)
+    {
+        m_events += "<" + XmlSax::toStringName(element) + ">";
+        return !m_stopAt || XmlSax::toStringName(element) != m_stopAt;
+    }
+    virtual bool exit(const XmlSax::String& element, bool)
+    {
+        m_events += "</" + XmlSax::toStringName(element) + ">";
+        return true;
+    }
+    virtual bool text(const XmlSax::String& content)
+    {
+        m_events += XmlSax::toStringText(content);
+        return true;
+    }
+    virtual void error(const char* info, const char*)
+    {
+        m_error = info;
+    }
+    virtual bool validate()
+    {
+        return true;
+    }
+
+    // Lint doc, and compare the diagnostics with "code@position" list
+    bool check(const char* doc, const char* diagnostics, const char* events)
+    {
+        XmlSax::Diagnostics found;
+        m_events.clear();
+        const bool valid = XmlSax(*this).lint(doc, found);
+
+        std::string s;
+        for (const auto& d : found)
+        {
+            s += std::to_string(static_cast<int>(d.code)) + "@" +
+                std::to_string(d.docPos - doc) + " ";
+        }
+        return valid == found.empty() && s == diagnostics && m_events == events;
+    }
+
+    bool run()
+    {
+        if (!check("<a x=\"1\"><b/>t</a>", "", "<a><b></b>t</a>") ||
+            // Elements above the matching one are closed
+            !check("<a><b><c></b>t</a>",
+                "2@9 ", "<a><b><c></c></b>t</a>") ||
+            // Unbalanced closing tag skipped, resynchronization at the next
+            // tag, open elements closed at the end
+            !check("<a></x><b x=\"1\" x=\"2\"/><bad <c>t",
+                "2@3 3@7 0@23 0@31 6@28 6@0 ",
+                "<a><b></b><c></c></a>") ||
+            !check("</x><a/>", "1@0 ", "<a></a>") ||
+            !check("<a>", "0@3 6@0 ", "<a></a>"))
+            return false;
+
+        // Messages as reported by parse()
+        static const char* const doc = "<a><b></a>";
+        XmlSax::Diagnostics found;
+        if (XmlSax(*this).lint(doc, found) || found.size() != 1 ||
+            found[0].code != XmlSax::MismatchedClosingTag ||
+            XmlSax(*this).parse(doc) || XmlSax::describe(found[0]) != m_error ||
+            m_error != "ERROR: closing attribute statement mismatch; expected \"b\"")
+            return false;
+
+        // Stopped by a callback: no diagnostics, but failure
+        m_stopAt = "b";
+        return !XmlSax(*this).lint("<a><b></c></a>", found) && found.empty();
+    }
+
+    std::string m_events;
+    std::string m_error;
+    const char* m_stopAt;
+};
+
+/// Namespace ULT
+struct XmlSaxNamespaceULT : XmlSaxNamespaces::Visitor
+{
+    virtual bool enter(const XmlSaxNamespaces::Name& element, bool)
+    {
+        m_events += "<" + name(element) + ">";
+        return true;
+    }
+    virtual bool exit(const XmlSaxNamespaces::Name& element, bool)
+    {
+        m_events += "</" + name(element) + ">";
+        return true;
+    }
+    virtual bool attribute(
+        const XmlSaxNamespaces::Name& attribute,
+        const XmlSax::String& value)
+    {
+        m_events += "@" + name(attribute) + "=" + XmlSax::toStringValue(value);
+        return true;
+    }
+    virtual void error(const char* info, const char*)
+    {
+        m_error = info;
+    }
+
+    static std::string name(const XmlSaxNamespaces::Name& n)
+    {
+        return std::to_string(n.ns) + ":" + XmlSax::toStringName(n.local);
+    }
+
+    bool run()
+    {
+        XmlSaxNamespaces resolver(*this);
+        const size_t env = resolver.intern("urn:env");
+        if (env != 3 || resolver.intern("urn:env") != env ||
+            resolver.uri(XmlSaxNamespaces::XmlNamespace) !=
+                "http://www.w3.org/XML/1998/namespace")
+            return false;
+
+        static const char* const doc =
+            "<env:Envelope xmlns:env=\"urn:env\" xmlns=\"urn:default\">"
+            "<env:Header><h a=\"1\" xml:lang=\"en\"/></env:Header>"
+            "<Body xmlns=\"\" xmlns:p=\"urn:p&amp;x\"><p:item p:id=\"2\"/></Body>"
+            "<p:late xmlns:p=\"urn:env\"/>"
+            "</env:Envelope>";
+        if (!XmlSax(resolver).parse(doc) || m_events !=
+            "<3:Envelope>@2:env=urn:env@2:xmlns=urn:default"
+            "<3:Header><4:h>@0:a=1@1:lang=en</4:h></3:Header>"
+            "<0:Body>@2:xmlns=@2:p=urn:p&x<5:item>@5:id=2</5:item></0:Body>"
+            "<3:late>@2:p=urn:env</3:late>"
+            "</3:Envelope>" ||
+            resolver.uri(5) != "urn:p&x")
+            return false;
+
+        // Bindings are popped at the end of the declaring element
+        m_events.clear();
+        if (XmlSax(resolver).parse("<a><b xmlns:p=\"u\"/><p:c/></a>") ||
+            m_error != "ERROR: unbound namespace prefix: \"p\"" ||
+            m_events != "<0:a><0:b>@2:p=u</0:b>")
+            return false;
+
+        resolver.reset();
+        m_events.clear();
+        if (XmlSax(resolver).parse("<a xmlns:p=\"\"/>") ||
+            m_error != "ERROR: empty namespace URI: \"xmlns:p\"")
+            return false;
+
+        resolver.reset();
+        return XmlSax(resolver).parse("<x:a xmlns:x=\"urn:env\" x:b=\"1\"/>") &&
+            m_events == "<3:a>@2:x=urn:env@3:b=1</3:a>";
+    }
+
+    std::string m_events;
+    std::string m_error;
+};
+
+/// Differential ULT: the same documents parsed by different engines
+/// (parser modes, snapshot replay, ...) have to produce identical event
+/// streams and error positions as XmlSax::parse(), the reference.
+/// The corpus: the documents of data[], generated ones, their random
+/// mutations (mostly invalid), and files listed in HO_SAX_ULT_CORPUS
+/// environment variable (separated by ';').
+/// If HO_SAX_ULT_BASELINE environment variable names a file, throughput
+/// of each engine on each corpus group is measured too (the best of a few
+/// runs, with a visitor doing nothing), and compared with the file's one;
+/// a slowdown beyond m_slowdown (or HO_SAX_ULT_SLOWDOWN environment
+/// variable, e.g. "1.5") fails the test. A missing file is created, to be
+/// the baseline of next runs.
+struct XmlSaxDifferentialULT
+{
+    /// Parse doc passing events to visitor; errors have to be passed
+    /// to visitor's error() as well.
+    typedef std::function<bool(const char* doc, XmlSax::Visitor& visitor)>
+        Engine;
+
+    XmlSaxDifferentialULT():
+        m_slowdown(1.25)
+    {}
+
+    XmlSaxDifferentialULT& add(const std::string& name, const Engine& engine)
+    {
+        m_engines.push_back(std::make_pair(name, engine));
+        return *this;
+    }
+
+    bool run()
+    {
+        // Parser objects reused for all the documents, as by a service
+        XmlSax reused(m_recorder);
+        XmlSax reusedQuiet(m_quiet);
+        std::vector<std::pair<std::string, Engine> > engines;
+        engines.push_back(std::make_pair("parse", Engine(parse)));
+        engines.push_back(std::make_pair("lint", Engine(lint)));
+        engines.push_back(std::make_pair("snapshot", Engine(snapshot)));
+        engines.push_back(std::make_pair("reuse",
+            Engine([&](const char* doc, XmlSax::Visitor& visitor) -> bool
+            {
+                assert(&visitor == &m_recorder || &visitor == &m_quiet);
+                return (&visitor == &m_recorder ? reused : reusedQuiet).parse(doc);
+            })));
+        engines.insert(engines.end(), m_engines.begin(), m_engines.end());
+
+        Corpus corpus;
+        makeCorpus(corpus);
+
+        for (const auto& group : corpus)
+        {
+            for (const auto& doc : group.second)
+            {
+                const std::string expected = record(engines[0].second, doc);
+                for (size_t n = 1; n < engines.size(); ++n)
+                {
+                    const std::string found = record(engines[n].second, doc);
+                    if (found != expected)
+                    {
+                        std::cout << "XmlSaxULT differential: " <<
+                            engines[n].first << " differs for:\n" << doc <<
+                            "\nexpected: " << expected <<
+                            "\nfound:    " << found << std::endl;
+                        return false;
+                    }
+                }
+            }
+        }
+
+        const char* const baseline = getenv("HO_SAX_ULT_BASELINE");
+        const char* const slowdown = getenv("HO_SAX_ULT_SLOWDOWN");
+        if (slowdown && atof(slowdown) >= 1)
+            m_slowdown = atof(slowdown);
+        return !baseline || checkThroughput(baseline, engines, corpus);
+    }
+
+    typedef std::vector<std::pair<std::string, std::vector<std::string> > >
+        Corpus;
+
+    // Logs all the events, with positions relative to the document
+    struct Recorder : XmlSax::Visitor
+    {
+        virtual bool enter(const XmlSax::String& element, bool isEmptyElementTag)
+        {
+            m_log += "<" + XmlSax::toStringName(element) +
+                (isEmptyElementTag ? "/ " : " ");
+            return true;
+        }
+        virtual bool exit(const XmlSax::String& element, bool isEmptyElementTag)
+        {
+            m_log += "</" + XmlSax::toStringName(element) +
+                (isEmptyElementTag ? "/ " : " ");
+            return true;
+        }
+        virtual bool attribute(const XmlSax::String& name, const XmlSax::String& value)
+        {
+            m_log += "@" + XmlSax::toStringName(name) + "=" +
+                XmlSax::toStringName(value) + " ";
+            return true;
+        }
+        virtual bool text(const XmlSax::String& content)
+        {
+            m_log += "T" + XmlSax::toStringName(content) + " ";
+            return true;
+        }
+        virtual bool cdata(const XmlSax::String& content)
+        {
+            m_log += "C" + XmlSax::toStringName(content) + " ";
+            return true;
+        }
+        // Note: doctype() isn't logged, as it's not replayed from snapshots
+        virtual void error(const char* info, const char* docPos)
+        {
+            m_log += "!" + std::to_string(docPos - m_doc) + ":" + info + " ";
+        }
+        virtual bool validate()
+        {
+            return true;
+        }
+
+        const char* m_doc;
+        std::string m_log;
+    };
+
+    // Drops the events, with the parser options of Recorder; for measuring
+    // the throughput of the engines, not of the logging
+    struct Quiet : XmlSax::Visitor
+    {
+        virtual bool validate()
+        {
+            return true;
+        }
+    };
+
+    // Passes the parser options only, dropping the events
+    struct Options : XmlSax::Visitor
+    {
+        Options(XmlSax::Visitor& visitor):
+            m_visitor(visitor)
+        {}
+
+        virtual bool validate()
+        {
+            return m_visitor.validate();
+        }
+        virtual bool utf8()
+        {
+            return m_visitor.utf8();
+        }
+
+        XmlSax::Visitor& m_visitor;
+    };
+
+    // Stops lint mode at the first error, where parse() stops
+    struct FirstError : XmlSaxFilter
+    {
+        FirstError(XmlSax::Visitor& next, const XmlSax::Diagnostics& diagnostics):
+            XmlSaxFilter(next),
+            m_diagnostics(diagnostics)
+        {}
+
+        virtual bool enter(const XmlSax::String& element, bool isEmptyElementTag)
+        { return m_diagnostics.empty() && m_next.enter(element, isEmptyElementTag); }
+        virtual bool exit(const XmlSax::String& element, bool isEmptyElementTag)
+        { return m_diagnostics.empty() && m_next.exit(element, isEmptyElementTag); }
+        virtual bool attribute(const XmlSax::String& name, const XmlSax::String& value)
+        { return m_diagnostics.empty() && m_next.attribute(name, value); }
+        virtual bool text(const XmlSax::String& content)
+        { return m_diagnostics.empty() && m_next.text(content); }
+        virtual bool cdata(const XmlSax::String& content)
+        { return m_diagnostics.empty() && m_next.cdata(content); }
+        virtual bool doctype(const XmlSax::String& declarations)
+        { return m_diagnostics.empty() && m_next.doctype(declarations); }
+
+        const XmlSax::Diagnostics& m_diagnostics;
+    };
+
+    static bool parse(const char* doc, XmlSax::Visitor& visitor)
+    {
+        return XmlSax(visitor).parse(doc);
+    }
+
+    static bool lint(const char* doc, XmlSax::Visitor& visitor)
+    {
+        XmlSax::Diagnostics diagnostics;
+        FirstError firstError(visitor, diagnostics);
+        const bool linted = XmlSax(firstError).lint(doc, diagnostics);
+        if (!diagnostics.empty())
+        {
+            visitor.error(XmlSax::describe(diagnostics[0]).c_str(),
+                diagnostics[0].docPos);
+        }
+        return linted;
+    }
+
+    // Replay of the snapshot; invalid documents have no snapshots
+    static bool snapshot(const char* doc, XmlSax::Visitor& visitor)
+    {
+        std::string snapshot;
+        Options options(visitor);
+        if (!XmlSaxSnapshot::create(doc, options, snapshot))
+            return XmlSax(visitor).parse(doc);
+        return XmlSaxSnapshot::replay(snapshot.data(), snapshot.size(), doc, visitor);
+    }
+
+    std::string record(const Engine& engine, const std::string& doc)
+    {
+        m_recorder.m_doc = doc.c_str();
+        m_recorder.m_log.clear();
+        const bool parsed = engine(doc.c_str(), m_recorder);
+        return m_recorder.m_log + (parsed ? "=1" : "=0");
+    }
+
+    static void makeCorpus(Corpus& corpus)
+    {
+        std::minstd_rand random(2016);
+        corpus.resize(3);
+        corpus[0].first = "data";
+        corpus[1].first = "generated";
+        corpus[2].first = "mutated";
+
+        for (const auto& d : data)
+            corpus[0].second.push_back(d.input);
+
+        for (int n = 0; n < 50; ++n)
+        {
+            std::string doc;
+            if (random() % 2)
+                doc += "<?xml version=\"1.0\"?>\n";
+            if (random() % 4 == 0)
+                doc += "<!DOCTYPE a [<!ELEMENT a ANY>]>";
+            generate(random, 0, doc);
+            corpus[1].second.push_back(doc);
+        }
+
+        for (const auto& doc : corpus[0].second)
+            corpus[2].second.push_back(mutate(random, doc));
+        for (const auto& doc : corpus[1].second)
+        {
+            for (int n = 0; n < 4; ++n)
+                corpus[2].second.push_back(mutate(random, doc));
+        }
+
+        const char* const files = getenv("HO_SAX_ULT_CORPUS");
+        for (const char* pos = files; pos && *pos;)
+        {
+            const char* const end = strchr(pos, ';');
+            const std::string path(pos, end ? end : pos + strlen(pos));
+            pos = end ? end + 1 : pos + strlen(pos);
+
+            std::string doc;
+            if (!path.empty() && XmlSaxIngest::readFile(path, doc))
+                corpus.push_back(std::make_pair(path, std::vector<std::string>(1, doc)));
+        }
+    }
+
+    // Random element with its subtree
+    static void generate(std::minstd_rand& random, int depth, std::string& doc)
+    {
+        static const char* const names[] = {
+            "a", "b", "ns:c", "d-e", "f.g", "_h" };
+        static const char* const attributes[] = {
+            "x", "y", "xml:lang", "xmlns:ns" };
+        static const char* const values[] = {
+            "", "1", " v &amp; w ", "&lt;&quot;" };
+        static const char* const contents[] = {
+            "text", " \n\t", "a &amp; b", "<![CDATA[ <x> ]] ]]>",
+            "<!-- comment -- -->", "<?pi x=\"1\"?>" };
+        const std::string name = pick(random, names);
+        doc += "<" + name;
+        for (size_t n = random() % 4; n; --n)
+        {
+            doc += std::string(random() % 2 ? " " : "\n ") +
+                pick(random, attributes) + "=\"" + pick(random, values) + "\"";
+        }
+        if (depth > 4 || random() % 4 == 0)
+        {
+            doc += "/>";
+            return;
+        }
+
+        doc += ">";
+        for (size_t n = random() % 5; n; --n)
+        {
+            if (random() % 2)
+                generate(random, depth + 1, doc);
+            else
+                doc += pick(random, contents);
+        }
+        doc += "</" + name + (random() % 4 ? ">" : " >");
+    }
+
+    template <size_t Size>
+    static const char* pick(std::minstd_rand& random, const char* const (&items)[Size])
+    {
+        return items[random() % Size];
+    }
+
+    // Document with 1-3 random edits: deletion, insertion, duplication
+    static std::string mutate(std::minstd_rand& random, std::string doc)
+    {
+        static const char alphabet[] = "<>/=\"'&;!?-[] \nax:";
+        for (size_t n = 1 + random() % 3; n && !doc.empty(); --n)
+        {
+            const size_t pos = random() % doc.size();
+            const size_t length = std::min<size_t>(1 + random() % 4, doc.size() - pos);
+            switch (random() % 3)
+            {
+            case 0:
+                doc.erase(pos, length);
+                break;
+            case 1:
+                doc.insert(pos, 1, alphabet[random() % (sizeof(alphabet) - 1)]);
+                break;
+            default:
+                doc.insert(pos, doc.substr(pos, length));
+                break;
+            }
+        }
+        return doc;
+    }
+
+    // Measure throughput (MB/s) of each engine on each corpus group,
+    // the best of Runs, and compare it with the baseline file, or create
+    // the file
+    bool checkThroughput(
+        const char* path,
+        const std::vector<std::pair<std::string, Engine> >& engines,
+        const Corpus& corpus)
+    {
+        std::map<std::string, double> baseline;
+        std::ifstream in(path);
+        const bool create = !in;
+        for (std::string group, engine; in >> group >> engine;)
+            in >> baseline[group + " " + engine];
+
+        std::ofstream out;
+        if (create)
+            out.open(path);
+
+        bool retCode = true;
+        for (const auto& group : corpus)
+        {
+            size_t bytes = 0;
+            for (const auto& doc : group.second)
+                bytes += doc.size();
+
+            for (const auto& engine : engines)
+            {
+                const std::string key = group.first + " " + engine.first;
+                double throughput = 0;
+                for (int run = 0; run < Runs; ++run)
+                {
+                    size_t total = 0;
+                    const auto start = std::chrono::steady_clock::now();
+                    std::chrono::duration<double> elapsed(0);
+                    while (elapsed.count() < 0.05)
+                    {
+                        for (const auto& doc : group.second)
+                            engine.second(doc.c_str(), m_quiet);
+                        total += bytes;
+                        elapsed = std::chrono::steady_clock::now() - start;
+                    }
+                    throughput = std::max(throughput, total / elapsed.count() / 1e6);
+                }
+
+                const auto it = baseline.find(key);
+                const bool slow =
+                    it != baseline.end() && throughput * m_slowdown < it->second;
+                std::cout << "XmlSaxULT throughput " << key << " " <<
+                    throughput << " MB/s" <<
+                    (it != baseline.end() ?
+                        " (baseline " + std::to_string(it->second) + ")" : "") <<
+                    (slow ? " SLOWDOWN" : "") << std::endl;
+                if (create)
+                    out << key << " " << throughput << "\n";
+                retCode = !slow && retCode;
+            }
+        }
+        return retCode;
+    }
+
+    enum
+    {
+        // Measurements of each throughput, the best one is taken
+        Runs = 5
+    };
+
+    std::vector<std::pair<std::string, Engine> > m_engines;
+    Recorder m_recorder;
+    Quiet m_quiet;
+    // Allowed ratio of the baseline throughput to the measured one
+    double m_slowdown;
+};
+
+/// Span ULT
+struct XmlSaxSpanULT : XmlSax::Visitor
+{
+    XmlSaxSpanULT():
+        m_outer(nullptr, nullptr)
+    {}
+
+    virtual bool exit(const XmlSax::String& element, bool)
+    {
+        m_spans += "/" + XmlSax::toStringName(element) + " ";
+        return true;
+    }
+    virtual bool span(
+        const XmlSax::String& element,
+        const XmlSax::String& outer,
+        const XmlSax::String& inner)
+    {
+        m_outer = outer;
+        m_spans += XmlSax::toStringName(element) + "[" +
+            XmlSax::toStringName(outer) + "|" + XmlSax::toStringName(inner) + "]";
+        return true;
+    }
+    virtual bool spans()
+    {
+        return true;
+    }
+
+    // Forwards the raw markup of "item" elements, skipping their content
+    struct Router : XmlSax::Visitor
+    {
+        Router(XmlSaxFanOut& fanOut, XmlWriter& writer):
+            m_fanOut(fanOut),
+            m_writer(writer)
+        {}
+
+        virtual bool enter(const XmlSax::String& element, bool)
+        {
+            if (XmlSax::toStringName(element) == "item")
+                m_fanOut.skip();
+            return true;
+        }
+        virtual bool span(
+            const XmlSax::String& element,
+            const XmlSax::String& outer,
+            const XmlSax::String&)
+        {
+            return XmlSax::toStringName(element) != "item" || m_writer.raw(outer);
+        }
+        virtual bool spans()
+        {
+            return true;
+        }
+
+        XmlSaxFanOut& m_fanOut;
+        XmlWriter& m_writer;
+    };
+
+    bool run()
+    {
+        // Spans are passed before exit()
+        static const char* const doc =
+            "<a x=\"1\"> <b>t<c/><!-- </b> --></b >\n<d></d></a>";
+        if (!XmlSax(*this).parse(doc) || m_spans !=
+            "c[<c/>|]/c "
+            "b[<b>t<c/><!-- </b> --></b >|t<c/><!-- </b> -->]/b "
+            "d[<d></d>|]/d "
+            "a[" + std::string(doc) + "| <b>t<c/><!-- </b> --></b >\n<d></d>]/a ")
+            return false;
+
+        // Elements closed by lint mode end where they have been closed
+        XmlSax::Diagnostics diagnostics;
+        m_spans.clear();
+        if (XmlSax(*this).lint("<a><b>x</a><", diagnostics) || m_spans !=
+            "b[<b>x|x]/b a[<a><b>x</a>|<b>x]/a ")
+            return false;
+
+        // Forwarding of subtrees without re-serialization
+        std::string routed;
+        {
+            XmlWriter writer(XmlWriter::stringSink(routed));
+            XmlSaxFanOut fanOut;
+            Router router(fanOut, writer);
+            fanOut.add(router);
+            if (!XmlSax(fanOut).parse(
+                    "<r><h/><item id=\"1\"> <p>&amp;</p> </item><item/></r>") ||
+                !writer.flush())
+                return false;
+        }
+        if (routed != "<item id=\"1\"> <p>&amp;</p> </item><item/>")
+            return false;
+
+        // Spans of an indexed element point into the document
+        static const char* const indexed = "<r><e><f/></e><e>x</e></r>";
+        XmlSaxIndex index;
+        m_spans.clear();
+        return index.build(indexed, "/r/e") && index.entries().size() == 2 &&
+            index.parseAt(indexed, index.entries()[1], *this) &&
+            m_spans == "e[<e>x</e>|x]/e /r " &&
+            m_outer.first == indexed + 14;
+    }
+
+    std::string m_spans;
+    XmlSax::String m_outer;
+};
+
+/// Binder ULT
+struct XmlSaxBinderULT
+{
+    struct Config
+    {
+        int port;
+        unsigned char level;
+        double ratio;
+        bool enabled;
+        bool secure;
+        std::string host;
+        std::string name;
+        std::vector<long> ids;
+        std::vector<std::string> tags;
+    };
+
+    bool run()
+    {
+        XmlSaxBinder<Config> binder;
+        binder.attribute("/config/server", "port", &Config::port)
+              .attribute("/config/server", "enabled", &Config::enabled)
+              .text("/config/server/host", &Config::host)
+              .attribute("/config/server/host", "name", &Config::name)
+              .text("/config/server/secure", &Config::secure)
+              .text("/config/ratio", &Config::ratio)
+              .attribute("/config/ratio", "level", &Config::level)
+              .text("/config/ids/id", &Config::ids)
+              .text("/config/tags/tag", &Config::tags);
+
+        static const char* const doc =
+            "<config><skipped><server port=\"1\"/></skipped>"
+            "<server port=\" 8080 \" enabled=\"true\" other=\"x\">"
+            "<host name=\" a&amp;lt;b \"> local  host </host>"
+            "<secure>\n 1 </secure></server>"
+            "<ratio level=\"7\">-1.5e3</ratio>"
+            "<ids><id>1</id><id> 2 </id><unbound>3</unbound><id>-3</id></ids>"
+            "</config>";
+        static const char* const badDoc =
+            "<config><ratio level=\"256\"/></config>";
+
+        Config config = Config();
+        if (!binder.parse(doc, config) ||
+            config.port != 8080 || !config.enabled ||
+            config.host != "local host" || config.name != " a&lt;b " ||
+            !config.secure || config.ratio != -1500.0 ||
+            config.level != 7 || config.ids.size() != 3 ||
+            config.ids[0] != 1 || config.ids[1] != 2 || config.ids[2] != -3)
+            return false;
+
+        // Content split by comments and CDATA is converted once
+        static const char* const splitDoc =
+            "<config><server><host>exa<!-- x -->mple &amp;<![CDATA[ &amp; ]]>"
+            "<?pi?>.com</host></server>"
+            "<ids><id>2<!-- -->3</id><id><![CDATA[4]]><!-- -->5</id></ids>"
+            "</config>";
+        static const char* const badSplitDoc =
+            "<config><ratio>1<!-- -->x</ratio></config>";
+
+        config = Config();
+        if (!binder.parse(splitDoc, config) ||
+            config.host != "example & &amp; .com" || config.ids.size() != 2 ||
+            config.ids[0] != 23 || config.ids[1] != 45)
+            return false;
+        if (binder.parse(badSplitDoc, config) ||
+            binder.errorPosition() != strstr(badSplitDoc, "1<"))
+            return false;
+
+        // Elements without content have the empty one
+        static const char* const emptyDocs[] = {
+            "<config><server><host></host></server>"
+            "<tags><tag>a</tag><tag></tag><tag>b</tag></tags></config>",
+            "<config><server><host/></server>"
+            "<tags><tag>a</tag><tag/><tag>b</tag></tags></config>" };
+        for (const char* emptyDoc : emptyDocs)
+        {
+            config = Config();
+            config.host = "x";
+            if (!binder.parse(emptyDoc, config) || !config.host.empty() ||
+                config.tags.size() != 3 || config.tags[0] != "a" ||
+                !config.tags[1].empty() || config.tags[2] != "b")
+                return false;
+        }
+        static const char* const emptyNumberDoc =
+            "<config><ids><id>1</id><id/></ids></config>";
+        if (binder.parse(emptyNumberDoc, config) ||
+            binder.errorPosition() != strstr(emptyNumberDoc, "id/>"))
+            return false;
+
+        return !binder.parse(badDoc, config) &&
+            binder.errorPosition() == strstr(badDoc, "256") &&
+            !binder.parse("<config>", config) && !binder.error().empty();
+    }
+};
+
+/// Callback results ULT: a callback returning false stops parsing
+struct XmlSaxCallbackULT : XmlSax::Visitor
+{
+    virtual bool exit(const XmlSax::String& element, bool)
+    {
+        m_events += "/" + XmlSax::toStringName(element);
+        return XmlSax::toStringName(element) != m_stopAt;
+    }
+    virtual bool attribute(const XmlSax::String& name, const XmlSax::String&)
+    {
+        m_events += "@" + XmlSax::toStringName(name);
+        return XmlSax::toStringName(name) != m_stopAt;
+    }
+
+    bool check(const char* doc, const char* stopAt, bool parsed, const char* events)
+    {
+        m_stopAt = stopAt;
+        m_events.clear();
+        return XmlSax(*this).parse(doc) == parsed && m_events == events;
+    }
+
+    bool run()
+    {
+        static const char* const doc = "<a x=\"1\" y=\"2\"><b/><c z=\"3\"/></a>";
+        return check(doc, "", true, "@x@y/b@z/c/a") &&
+            check(doc, "x", false, "@x") &&
+            check(doc, "b", false, "@x@y/b") &&
+            check(doc, "c", false, "@x@y/b@z/c") &&
+            check(doc, "a", false, "@x@y/b@z/c/a") &&
+            // Truncated inside an open element: an error, not an assertion
+            check("<a><b>", "", false, "");
+    }
+
+    std::string m_stopAt;
+    std::string m_events;
+};
+
 /// SAX ULT
 struct XmlSaxULT : XmlSax::Visitor
 {
@@ -548,6 +2718,17 @@ struct XmlSaxULT : XmlSax::Visitor
                 }
             }
 
+            if (passed && m_PositiveTest)
+            {
+                passed = replaySnapshot(data[n]);
+                failureDesc = "positive test: snapshot replay != expected pattern.";
+            }
+            if (passed && m_PositiveTest)
+            {
+                passed = rewrite(data[n]);
+                failureDesc = "positive test: rewritten document != expected pattern.";
+            }
+
             allPassed = allPassed && passed;
 
             tee("\n====================\n");
@@ -557,9 +2738,105 @@ struct XmlSaxULT : XmlSax::Visitor
             assert(!m_EnableAssertions || passed);
         }
 
+        allPassed = check("diff", XmlSaxDiffULT().run()) && allPassed;
+        allPassed = check("callbacks", XmlSaxCallbackULT().run()) && allPassed;
+        allPassed = check("conversions", XmlSaxConversionULT().run()) && allPassed;
+        allPassed = check("decoders", XmlSaxDecodeULT().run()) && allPassed;
+        allPassed = check("writer", XmlWriterULT().run()) && allPassed;
+        allPassed = check("utf-8", XmlSaxUtf8ULT().run()) && allPassed;
+        allPassed = check("fragments", XmlSaxFragmentsULT().run()) && allPassed;
+        allPassed = check("pipeline", XmlSaxPipelineULT().run()) && allPassed;
+        allPassed = check("stream", XmlSaxStreamULT().run()) && allPassed;
+        allPassed = check("index", XmlSaxIndexULT().run()) && allPassed;
+        allPassed = check("hasher", XmlSaxHasherULT().run()) && allPassed;
+        allPassed = check("schema", XmlSaxSchemaULT().run()) && allPassed;
+        allPassed = check("memory", XmlSaxMemoryULT().run()) && allPassed;
+        allPassed = check("ingest", XmlSaxIngestULT().run()) && allPassed;
+        allPassed = check("dispatch", XmlSaxDispatchULT().run()) && allPassed;
+        allPassed = check("features", XmlSaxFeaturesULT().run()) && allPassed;
+        allPassed = check("lint", XmlSaxLintULT().run()) && allPassed;
+        allPassed = check("namespace", XmlSaxNamespaceULT().run()) && allPassed;
+        allPassed = check("differential", XmlSaxDifferentialULT().run()) && allPassed;
+        allPassed = check("span", XmlSaxSpanULT().run()) && allPassed;
+        allPassed = check("binder", XmlSaxBinderULT().run()) && allPassed;
+
         return allPassed;
     }
 
+    bool check(const char* name, bool passed)
+    {
+        std::cout << "XmlSaxULT " << name << "  " <<
+            (passed ? "passed" : "failed") << std::endl;
+        assert(!m_EnableAssertions || passed);
+        return passed;
+    }
+
+    // Record the parse to a snapshot, and check the replayed output
+    bool replaySnapshot(const Data& d)
+    {
+        std::string snapshot;
+        std::string parsed;
+        std::swap(parsed, m_parsed);
+        if (!XmlSaxSnapshot::create(d.input, *this, snapshot) ||
+            !XmlSaxSnapshot::matches(snapshot.data(), snapshot.size(), d.input) ||
+            XmlSaxSnapshot::matches(snapshot.data(), snapshot.size(), "<a/>"))
+        {
+            return false;
+        }
+
+        // A document of other length doesn't match, even with the same hash
+        // (stored after the magic, the version and the length)
+        const std::string longer = std::string(d.input) + " ";
+        const uint64_t longerHash = XmlSax::hash(
+            XmlSax::String(longer.data(), longer.data() + longer.size()));
+        std::string forged = snapshot;
+        memcpy(&forged[2 * sizeof(uint32_t) + sizeof(uint64_t)],
+            &longerHash, sizeof(longerHash));
+        if (XmlSaxSnapshot::matches(forged.data(), forged.size(), longer.c_str()))
+            return false;
+
+        m_parsed.clear();
+        m_ClosePreviousElement = false;
+        const bool replayed = XmlSaxSnapshot::replay(
+            snapshot.data(), snapshot.size(), d.input, *this);
+        std::swap(parsed, m_parsed);
+        return replayed && !diff(d.outputOrPos, parsed);
+    }
+
+    // Copy the document with the writer, and check the output parsed
+    bool rewrite(const Data& d)
+    {
+        std::string written;
+        {
+            XmlWriter writer(XmlWriter::stringSink(written), nullptr, 16);
+            XmlWriterVisitor visitor(writer);
+            if (!XmlSax(visitor).parse(d.input) || !writer.flush())
+                return false;
+        }
+
+        std::string parsed;
+        std::swap(parsed, m_parsed);
+        m_ClosePreviousElement = false;
+        const bool reparsed = XmlSax(*this).parse(written.c_str());
+        std::swap(parsed, m_parsed);
+
+        // Adjacent text chunks (e.g. separated by comments) are joined
+        // in the written document, so compare ignoring white spaces
+        return reparsed &&
+            !diff(removeSpaces(d.outputOrPos), removeSpaces(parsed));
+    }
+
+    static std::string removeSpaces(const std::string& s)
+    {
+        std::string result;
+        for (const char c : s)
+        {
+            if (!isspace(static_cast<unsigned char>(c)))
+                result += c;
+        }
+        return result;
+    }
+
     std::string m_parsed;
     bool m_ClosePreviousElement;
     const char* m_ErrorPosInString;
@@ -0,0 +1,488 @@
+/*
+MIT License
+
+Copyright (c) 2016 Maciej Kalinski https://github.com/rumcays
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/*
+    @file  ho_xml_writer.hpp
+
+    @description
+    This is a part of header-only (see: wiki Header-only) tiny utils library.
+
+    Streaming XML writer, the counterpart of the XmlSax parser.
+    Output is collected in a reusable buffer, and passed to a sink
+    (a callback, e.g. writing to a file) whenever the buffer fills up,
+    on flush(), and on destruction.
+    The writer's events map 1:1 to XmlSax::Visitor callbacks; start tag
+    is completed with '>' or "/>" by the event following the attributes.
+    Escaping: content passed to attribute(), text() is escaped; runs of
+    characters not requiring escaping are copied as a whole. Content
+    which is already escaped (e.g. as matched by the parser) may be
+    written as it is with raw*() methods - that's what XmlWriterVisitor
+    does, so parse -> filter -> write pipelines do not re-escape anything;
+    only what the lenient parser accepts, but is not well-formed output,
+    is escaped there: a bare '&', and the '>' of "]]>" in text.
+
+    Optional pretty-printing indents elements by the given string;
+    it's meant for data documents - white spaces are added around
+    the elements, also inside of mixed content.
+
+    Sink failure is sticky: all subsequent methods return false,
+    and write nothing (the buffered output is dropped).
+
+    Usage:
+        XmlWriter writer(XmlWriter::fileSink(stdout), "  ");
+        writer.enter(XmlWriter::str("root"));
+        writer.attribute(XmlWriter::str("a"), XmlWriter::str("x < y"));
+        writer.text(XmlWriter::str("Tom & Jerry"));
+        writer.exit(XmlWriter::str("root"));
+*/
+
+#ifndef HO_XML_WRITER_HPP_
+#define HO_XML_WRITER_HPP_
+
+#include <cstdio>
+#include <functional>
+#include "ho_sax.hpp"
+
+namespace headeronly
+{
+class XmlWriter
+{
+public: // types
+    typedef XmlSax::String String;
+
+    /// Output callback; return false on failure
+    typedef std::function<bool(const char* data, size_t size)> Sink;
+
+public: // constructors
+    XmlWriter(
+        const Sink& sink,
+        const char* indent = nullptr,
+        size_t bufferSize = 64 * 1024):
+        m_sink(sink),
+        m_indent(indent ? indent : ""),
+        m_bufferSize(bufferSize),
+        m_depth(0),
+        m_startTagOpen(false),
+        m_lastWasElement(false),
+        m_written(false),
+        m_brackets(0),
+        m_failed(false)
+    {
+        m_buffer.reserve(m_bufferSize);
+    }
+
+    ~XmlWriter()
+    {
+        flush();
+    }
+
+public: // function members
+    bool enter(const String& element, bool isEmptyElementTag = false)
+    {
+        if (m_failed)
+            return false;
+
+        closeStartTag();
+        newLine(m_depth);
+
+        put('<');
+        put(element);
+
+        m_written = true;
+        m_brackets = 0;
+        m_startTagOpen = true;
+        m_lastWasElement = false;
+        if (!isEmptyElementTag)
+            ++m_depth;
+
+        return check();
+    }
+    bool exit(const String& element, bool isEmptyElementTag = false)
+    {
+        if (m_failed)
+            return false;
+
+        if (isEmptyElementTag)
+        {
+            assert(m_startTagOpen);
+            put("/>", 2);
+            m_startTagOpen = false;
+        }
+        else
+        {
+            assert(m_depth > 0);
+            --m_depth;
+            closeStartTag();
+            if (m_lastWasElement)
+                newLine(m_depth);
+            put("</", 2);
+            put(element);
+            put('>');
+        }
+
+        m_brackets = 0;
+        m_lastWasElement = true;
+        return check();
+    }
+    bool attribute(const String& name, const String& value)
+    {
+        return attributeStart(name) && escape(value, true) && attributeEnd();
+    }
+    bool text(const String& content)
+    {
+        if (m_failed)
+            return false;
+
+        closeStartTag();
+        escape(content, false);
+        endText(content);
+        return check();
+    }
+    // Sequences of "]]>" are split between CDATA sections
+    bool cdata(const String& content)
+    {
+        if (m_failed)
+            return false;
+
+        closeStartTag();
+        put("<![CDATA[", 9);
+
+        const char* begin = content.first;
+        for (const char* pos = begin; content.second - pos >= 3; ++pos)
+        {
+            if (pos[0] == ']' && pos[1] == ']' && pos[2] == '>')
+            {
+                put(String(begin, pos + 2));
+                put("]]><![CDATA[", 12);
+                begin = pos + 2;
+            }
+        }
+        put(String(begin, content.second));
+
+        put("]]>", 3);
+        m_written = true;
+        m_brackets = 0;
+        m_lastWasElement = false;
+        return check();
+    }
+
+    // Write already escaped content; a bare '&' (not starting a character
+    // reference, nor one of the predefined entities) is escaped, and so is
+    // the '>' of "]]>" in text, also if "]]" ended the previous text
+    bool rawAttribute(const String& name, const String& value)
+    {
+        return attributeStart(name) && escapeRaw(value, false) && attributeEnd();
+    }
+    bool rawText(const String& content)
+    {
+        if (m_failed)
+            return false;
+
+        closeStartTag();
+        escapeRaw(content, true);
+        endText(content);
+        return check();
+    }
+    // Write XML markup as it is, e.g. a copied subtree (see
+    // XmlSax::Visitor::span()); big chunks go to the sink without copying
+    bool raw(const String& content)
+    {
+        if (m_failed)
+            return false;
+
+        closeStartTag();
+        put(content);
+        m_written = true;
+        m_brackets = 0;
+        m_lastWasElement = true;
+        return check();
+    }
+
+    // Pass the buffered output to the sink
+    bool flush()
+    {
+        if (!m_failed && !m_buffer.empty())
+            m_failed = !m_sink(m_buffer.data(), m_buffer.size());
+        m_buffer.clear();
+        return !m_failed;
+    }
+
+    // Auxiliary: whole C-string as the writer's content
+    static String str(const char* s)
+    {
+        assert(s);
+        return String(s, s + strlen(s));
+    }
+
+    // Sink writing to a C file
+    static Sink fileSink(FILE* file)
+    {
+        assert(file);
+        return [file](const char* data, size_t size)
+        {
+            return fwrite(data, 1, size, file) == size;
+        };
+    }
+
+    // Sink appending to a string
+    static Sink stringSink(std::string& s)
+    {
+        return [&s](const char* data, size_t size)
+        {
+            s.append(data, size);
+            return true;
+        };
+    }
+
+private: // functions
+    // Output of a failed writer is dropped, not to grow the buffer
+    bool check()
+    {
+        if (m_buffer.size() >= m_bufferSize || m_failed)
+            flush();
+        return !m_failed;
+    }
+
+    void put(char c)
+    {
+        m_buffer.push_back(c);
+    }
+
+    void put(const char* s, size_t size)
+    {
+        m_buffer.append(s, size);
+    }
+
+    void put(const String& s)
+    {
+        assert(s.first <= s.second);
+
+        // Pass big chunks to the sink directly
+        const size_t size = static_cast<size_t>(s.second - s.first);
+        if (size >= m_bufferSize && flush())
+            m_failed = !m_sink(s.first, size);
+        else
+            m_buffer.append(s.first, s.second);
+    }
+
+
+    void closeStartTag()
+    {
+        if (!m_startTagOpen)
+            return;
+        put('>');
+        m_startTagOpen = false;
+        m_brackets = 0;
+    }
+
+    // After text content was written
+    void endText(const String& content)
+    {
+        m_written = true;
+        m_lastWasElement = false;
+
+        // The ']' ending the text, see escapeRaw()
+        const char* pos = content.second;
+        size_t brackets = 0;
+        while (brackets < 2 && pos != content.first && pos[-1] == ']')
+        {
+            --pos;
+            ++brackets;
+        }
+        if (pos == content.first)
+            brackets = std::min<size_t>(brackets + m_brackets, 2);
+        m_brackets = brackets;
+    }
+
+    // Check if pos of s follows "]]", maybe ended by the previous text
+    bool followsBrackets(const String& s, const char* pos) const
+    {
+        size_t brackets = 0;
+        while (brackets < 2 && pos != s.first && pos[-1] == ']')
+        {
+            --pos;
+            ++brackets;
+        }
+        return brackets == 2 || (pos == s.first && brackets + m_brackets >= 2);
+    }
+
+    // Nothing but the first element's start tag is at the beginning
+    // of a line (regardless of flushes of the buffer)
+    void newLine(size_t depth)
+    {
+        if (m_indent.empty() || (!depth && !m_written && !m_lastWasElement))
+            return;
+        put('\n');
+        for (size_t n = 0; n < depth; ++n)
+            m_buffer += m_indent;
+    }
+
+    bool attributeStart(const String& name)
+    {
+        if (m_failed)
+            return false;
+
+        assert(m_startTagOpen);
+        put(' ');
+        put(name);
+        put("=\"", 2);
+        return !m_failed;
+    }
+
+    bool attributeEnd()
+    {
+        put('"');
+        return check();
+    }
+
+    // Escape XML special characters; quotes only in attribute values
+    bool escape(const String& s, bool isAttribute)
+    {
+        assert(s.first <= s.second);
+
+        const char* begin = s.first;
+        for (const char* pos = begin; pos != s.second; ++pos)
+        {
+            const char* replacement = nullptr;
+            switch (*pos)
+            {
+            case '<': replacement = "&lt;"; break;
+            case '>': replacement = "&gt;"; break;
+            case '&': replacement = "&amp;"; break;
+            case '"': replacement = isAttribute ? "&quot;" : nullptr; break;
+            case '\'': replacement = isAttribute ? "&apos;" : nullptr; break;
+            default: break;
+            }
+            if (!replacement)
+                continue;
+
+            m_buffer.append(begin, pos);
+            m_buffer.append(replacement);
+            begin = pos + 1;
+        }
+        m_buffer.append(begin, s.second);
+
+        return !m_failed;
+    }
+
+    // Copy escaped content, escaping bare '&', and in text the '>'
+    // following "]]" (see m_brackets); runs between them are put as a whole
+    bool escapeRaw(const String& s, bool isText)
+    {
+        assert(s.first <= s.second);
+
+        const char* begin = s.first;
+        for (const char* pos = begin; pos != s.second; ++pos)
+        {
+            if (*pos == '&' && !isReference(pos + 1, s.second))
+            {
+                put(String(begin, pos + 1));
+                put("amp;", 4);
+                begin = pos + 1;
+            }
+            else if (*pos == '>' && isText && followsBrackets(s, pos))
+            {
+                put(String(begin, pos));
+                put("&gt;", 4);
+                begin = pos + 1;
+            }
+        }
+        put(String(begin, s.second));
+
+        return !m_failed;
+    }
+
+    // Check if [pos, end) starts with the rest of a reference (after '&'):
+    // a character reference, or a predefined entity
+    static bool isReference(const char* pos, const char* end)
+    {
+        if (pos != end && *pos == '#')
+        {
+            const bool hex = ++pos != end && *pos == 'x';
+            pos += hex ? 1 : 0;
+            const char* const digits = pos;
+            while (pos != end && (hex ?
+                isxdigit(static_cast<unsigned char>(*pos)) :
+                isdigit(static_cast<unsigned char>(*pos))))
+                ++pos;
+            return pos != digits && pos != end && *pos == ';';
+        }
+
+        char c = 0;
+        return XmlSax::unescape(pos, end, c) > 0;
+    }
+
+private: // data
+    Sink m_sink;
+    std::string m_indent;
+    size_t m_bufferSize;
+    std::string m_buffer;
+
+    size_t m_depth;
+    // Attributes may be added
+    bool m_startTagOpen;
+    // For pretty-printing: the last written was a tag
+    bool m_lastWasElement;
+    // Anything has been written (maybe flushed already)
+    bool m_written;
+    // Number of ']' (up to 2) ending the last written text
+    size_t m_brackets;
+    bool m_failed;
+};
+
+/// Forwards parser's events to the writer, as they are in the input document
+struct XmlWriterVisitor : XmlSax::Visitor
+{
+    XmlWriterVisitor(XmlWriter& writer):
+        m_writer(writer)
+    {}
+
+    virtual bool enter(const XmlSax::String& element, bool isEmptyElementTag)
+    {
+        return m_writer.enter(element, isEmptyElementTag);
+    }
+    virtual bool exit(const XmlSax::String& element, bool isEmptyElementTag)
+    {
+        return m_writer.exit(element, isEmptyElementTag);
+    }
+    virtual bool attribute(
+        const XmlSax::String& name,
+        const XmlSax::String& value)
+    {
+        return m_writer.rawAttribute(name, value);
+    }
+    virtual bool text(const XmlSax::String& content)
+    {
+        return m_writer.rawText(content);
+    }
+    virtual bool cdata(const XmlSax::String& content)
+    {
+        return m_writer.cdata(content);
+    }
+
+    XmlWriter& m_writer;
+};
+} // headeronly
+
+#endif // HO_XML_WRITER_HPP_